@@ -0,0 +1,273 @@
+#include <android/log.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <dlfcn.h>
+#include <sys/mman.h>
+
+#define CORE_BUILD
+#include "core.h"
+
+#undef log
+#define log(...) __android_log_print(ANDROID_LOG_INFO, "QuestHook", "[Core] " __VA_ARGS__)
+
+// One entry per hooked method, shared by every mod
+typedef struct core_hook {
+    const char* name;
+    uint32_t address;
+    // The method jumps to this thunk, which jumps to the newest hook
+    uint32_t* thunk;
+    // Newest hook
+    void* hook;
+    // Original pointer of the oldest hook, it holds the trampoline to the game's code
+    void** original;
+    int count;
+} core_hook_t;
+
+// ARM "ldr pc, [pc, #-4]": jumps to the address in the next word (Thumb if its low bit is set)
+#define CORE_THUNK_LDR_PC 0xE51FF004
+#define CORE_THUNK_WORDS 2
+#define CORE_THUNK_PAGE_SIZE 4096
+
+static pthread_mutex_t core_lock = PTHREAD_MUTEX_INITIALIZER;
+static core_hook_t* core_hooks = NULL;
+static int core_hook_count = 0;
+static int core_hook_capacity = 0;
+static long long core_base = 0;
+// Page the next thunk is cut from, thunks are never freed
+static uint32_t* core_thunk_page = NULL;
+static int core_thunk_used = CORE_THUNK_PAGE_SIZE / sizeof(uint32_t);
+
+long long core_real_offset(long long offset) {
+    long long base = __atomic_load_n(&core_base, __ATOMIC_ACQUIRE);
+    if (base == 0) {
+        // A failed lookup (libil2cpp not loaded yet) is not cached
+        base = getRealOffset(0);
+        __atomic_store_n(&core_base, base, __ATOMIC_RELEASE);
+    }
+    return base + offset;
+}
+
+static core_hook_t* core_find_hook(uint32_t address) {
+    for (int i = 0; i < core_hook_count; i++) {
+        if (core_hooks[i].address == address) {
+            return &core_hooks[i];
+        }
+    }
+    return NULL;
+}
+
+static core_hook_t* core_add_hook() {
+    if (core_hook_count == core_hook_capacity) {
+        int capacity = core_hook_capacity ? core_hook_capacity * 2 : 64;
+        core_hook_t* hooks = realloc(core_hooks, capacity * sizeof(core_hook_t));
+        if (!hooks) {
+            return NULL;
+        }
+        core_hooks = hooks;
+        core_hook_capacity = capacity;
+    }
+    return &core_hooks[core_hook_count++];
+}
+
+// Makes a thunk that jumps to `target`. Must hold core_lock.
+static uint32_t* core_new_thunk(void* target) {
+    if (core_thunk_used + CORE_THUNK_WORDS > CORE_THUNK_PAGE_SIZE / sizeof(uint32_t)) {
+        void* page = mmap(NULL, CORE_THUNK_PAGE_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (page == MAP_FAILED) {
+            return NULL;
+        }
+        core_thunk_page = page;
+        core_thunk_used = 0;
+    }
+    uint32_t* thunk = core_thunk_page + core_thunk_used;
+    core_thunk_used += CORE_THUNK_WORDS;
+    thunk[0] = CORE_THUNK_LDR_PC;
+    thunk[1] = (uint32_t)target;
+    __builtin___clear_cache((char*)thunk, (char*)(thunk + CORE_THUNK_WORDS));
+    return thunk;
+}
+
+// Puts the new hook in front of the chain. The game's code and every trampoline stay as they are: the new hook's
+// original pointer is set to the previous hook first, then the thunk's target word is switched to the new hook in
+// one aligned store. The thunk loads its target as data, so a thread entering the method at any time runs either
+// the old chain or the new one, and nothing it may be running is freed.
+static int core_chain_hook(core_hook_t* entry, const char* name, void* hook, void** original) {
+    *original = entry->hook;
+    __atomic_store_n(&entry->thunk[1], (uint32_t)hook, __ATOMIC_RELEASE);
+    entry->hook = hook;
+    entry->count++;
+    log("Chained %s onto %s, %i hooks at 0x%X", name, entry->name, entry->count, entry->address);
+    return 0;
+}
+
+int core_install_hook(const char* name, long long offset, void* hook, void** original) {
+    uint32_t address = (uint32_t)core_real_offset(offset);
+    pthread_mutex_lock(&core_lock);
+    core_hook_t* entry = core_find_hook(address);
+    if (entry) {
+        int r = core_chain_hook(entry, name, hook, original);
+        pthread_mutex_unlock(&core_lock);
+        return r;
+    }
+    // Reserved first, a method that is hooked has to stay chainable
+    entry = core_add_hook();
+    uint32_t* thunk = entry ? core_new_thunk(hook) : NULL;
+    if (!thunk || registerInlineHook(address, (uint32_t)thunk, (uint32_t**)original) != ELE7EN_OK || inlineHook(address) != ELE7EN_OK) {
+        if (entry) {
+            core_hook_count--;
+        }
+        pthread_mutex_unlock(&core_lock);
+        log("Could not install hook: %s at offset: 0x%llX", name, offset);
+        return -1;
+    }
+    entry->name = name;
+    entry->address = address;
+    entry->thunk = thunk;
+    entry->hook = hook;
+    entry->original = original;
+    entry->count = 1;
+    pthread_mutex_unlock(&core_lock);
+    return 0;
+}
+
+int core_hooked_method_count() {
+    pthread_mutex_lock(&core_lock);
+    int count = core_hook_count;
+    pthread_mutex_unlock(&core_lock);
+    return count;
+}
+
+// Start and end of the libil2cpp.so mappings, 0 if it is not loaded
+static uintptr_t core_library_end(uintptr_t base) {
+    FILE* maps = fopen("/proc/self/maps", "r");
+    if (!maps) {
+        return 0;
+    }
+    uintptr_t end = 0;
+    char line[512];
+    while (fgets(line, sizeof(line), maps)) {
+        unsigned long start, stop;
+        if (strstr(line, "libil2cpp.so") && sscanf(line, "%lx-%lx", &start, &stop) == 2 && start >= base && stop > end) {
+            end = stop;
+        }
+    }
+    fclose(maps);
+    return end;
+}
+
+int core_resolve_signatures(sigscan_signature_t* signatures, int count) {
+    uintptr_t base = (uintptr_t)core_real_offset(0);
+    uintptr_t end = base ? core_library_end(base) : 0;
+    if (end <= base) {
+        log("Could not find libil2cpp.so to resolve %i signatures!", count);
+        return -1;
+    }
+    sigscan_image_t image = { (const uint8_t*)base, end - base, '\1' };
+    // Scanning and the cache file are shared by every mod
+    pthread_mutex_lock(&core_lock);
+    int found = sigscan_resolve(&image, CORE_OFFSET_CACHE_FILE, signatures, count);
+    pthread_mutex_unlock(&core_lock);
+    for (int i = 0; i < count; i++) {
+        if (signatures[i].matches != 1) {
+            log("Signature %s matched %i times, not using it!", signatures[i].name, signatures[i].matches);
+        }
+    }
+    log("Resolved %i of %i signatures", found, count);
+    return found;
+}
+
+// The parts of the il2cpp API the core uses, looked up once
+typedef struct core_il2cpp_api {
+    void* (*domain_get)();
+    void* (*domain_assembly_open)(void* domain, const char* name);
+    void* (*assembly_get_image)(void* assembly);
+    void* (*class_from_name)(void* image, const char* namespaze, const char* name);
+    void* (*class_get_method_from_name)(void* klass, const char* name, int argc);
+    void* (*class_get_type)(void* klass);
+    void* (*type_get_object)(void* type);
+    void* (*object_new)(void* klass);
+    uint32_t (*gchandle_new)(void* object, char pinned);
+    void (*gchandle_free)(uint32_t handle);
+} core_il2cpp_api_t;
+
+static core_il2cpp_api_t core_il2cpp;
+static pthread_once_t core_il2cpp_once = PTHREAD_ONCE_INIT;
+static char core_il2cpp_loaded = '\0';
+
+static void core_load_il2cpp_api() {
+    void* library = dlopen("libil2cpp.so", RTLD_NOW | RTLD_NOLOAD);
+    if (!library) {
+        log("Could not open libil2cpp.so for its API: %s", dlerror());
+        return;
+    }
+    core_il2cpp.domain_get = dlsym(library, "il2cpp_domain_get");
+    core_il2cpp.domain_assembly_open = dlsym(library, "il2cpp_domain_assembly_open");
+    core_il2cpp.assembly_get_image = dlsym(library, "il2cpp_assembly_get_image");
+    core_il2cpp.class_from_name = dlsym(library, "il2cpp_class_from_name");
+    core_il2cpp.class_get_method_from_name = dlsym(library, "il2cpp_class_get_method_from_name");
+    core_il2cpp.class_get_type = dlsym(library, "il2cpp_class_get_type");
+    core_il2cpp.type_get_object = dlsym(library, "il2cpp_type_get_object");
+    core_il2cpp.object_new = dlsym(library, "il2cpp_object_new");
+    core_il2cpp.gchandle_new = dlsym(library, "il2cpp_gchandle_new");
+    core_il2cpp.gchandle_free = dlsym(library, "il2cpp_gchandle_free");
+    void** functions = (void**)&core_il2cpp;
+    for (size_t i = 0; i < sizeof(core_il2cpp) / sizeof(void*); i++) {
+        if (!functions[i]) {
+            log("libil2cpp.so is missing il2cpp API function %u!", (unsigned int)i);
+            return;
+        }
+    }
+    core_il2cpp_loaded = '\1';
+}
+
+static void* core_il2cpp_class(const char* assembly, const char* namespaze, const char* klass) {
+    pthread_once(&core_il2cpp_once, core_load_il2cpp_api);
+    if (!core_il2cpp_loaded) {
+        return NULL;
+    }
+    void* loaded = core_il2cpp.domain_assembly_open(core_il2cpp.domain_get(), assembly);
+    void* image = loaded ? core_il2cpp.assembly_get_image(loaded) : NULL;
+    void* found = image ? core_il2cpp.class_from_name(image, namespaze, klass) : NULL;
+    if (!found) {
+        log("Could not find class %s.%s in %s!", namespaze, klass, assembly);
+    }
+    return found;
+}
+
+void* core_il2cpp_method(const char* assembly, const char* namespaze, const char* klass, const char* method, int argc) {
+    void* found = core_il2cpp_class(assembly, namespaze, klass);
+    // MethodInfo starts with the method's code pointer
+    void** info = found ? core_il2cpp.class_get_method_from_name(found, method, argc) : NULL;
+    if (!info || !*info) {
+        log("Could not find method %s.%s.%s with %i parameters!", namespaze, klass, method, argc);
+        return NULL;
+    }
+    return *info;
+}
+
+void* core_il2cpp_type_object(const char* assembly, const char* namespaze, const char* klass) {
+    void* found = core_il2cpp_class(assembly, namespaze, klass);
+    return found ? core_il2cpp.type_get_object(core_il2cpp.class_get_type(found)) : NULL;
+}
+
+void* core_il2cpp_object_new(const char* assembly, const char* namespaze, const char* klass) {
+    void* found = core_il2cpp_class(assembly, namespaze, klass);
+    return found ? core_il2cpp.object_new(found) : NULL;
+}
+
+uint32_t core_il2cpp_keep_alive(void* object) {
+    pthread_once(&core_il2cpp_once, core_load_il2cpp_api);
+    if (!core_il2cpp_loaded || !object) {
+        return 0;
+    }
+    return core_il2cpp.gchandle_new(object, '\0');
+}
+
+void core_il2cpp_release(uint32_t handle) {
+    if (core_il2cpp_loaded && handle != 0) {
+        core_il2cpp.gchandle_free(handle);
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef CORE_H
+#define CORE_H
+
+#include "../beatsaber-hook/shared/inline-hook/inlineHook.h"
+#include "../beatsaber-hook/shared/utils/utils.h"
+#include "sigscan.h"
+
+// Shared core library, built as lib0questhookcore.so. It holds the only copy of the beatsaber-hook utils and
+// inline hook code, so every mod that links against it shares one hook table and one libil2cpp base address.
+// Include this instead of utils.h / inlineHook.h. It makes getRealOffset and INSTALL_HOOK go through the
+// core, so mod code does not change.
+
+// libil2cpp.so base + offset. The base is looked up once for the whole process, getRealOffset
+// reads /proc/self/maps every time.
+long long core_real_offset(long long offset);
+
+// Hooks the method at the given offset. If another mod already hooked it, the new hook is chained in front:
+// it runs first and its original pointer calls the previous hook, which calls the game's method.
+// Meant to be called at load time, like INSTALL_HOOK. Chaining onto a hooked method only switches the target
+// of the core's thunk for it, so it is also safe while game threads run the method. Returns 0 on success.
+int core_install_hook(const char* name, long long offset, void* hook, void** original);
+
+// Number of distinct methods hooked by all mods
+int core_hooked_method_count();
+
+// Methods and types with no known offset, looked up by name through the il2cpp API exported by
+// libil2cpp.so. Assemblies are named without .dll, e.g. "UnityEngine.CoreModule". Lookups walk il2cpp's
+// metadata, so do them once and keep the result. All of these return NULL if the lookup fails.
+
+// Code pointer of the first method with that name and number of parameters. Call it like an offset from
+// getRealOffset: instance methods take self first.
+void* core_il2cpp_method(const char* assembly, const char* namespaze, const char* klass, const char* method, int argc);
+// The System.Type object of a class, e.g. for AssetBundle.LoadAssetAsync(string, Type)
+void* core_il2cpp_type_object(const char* assembly, const char* namespaze, const char* klass);
+// Allocates an object of the class, its constructor still has to be called
+void* core_il2cpp_object_new(const char* assembly, const char* namespaze, const char* klass);
+// Keeps a managed object alive while native code holds on to it, the GC does not see the mods' memory.
+// Returns the GC handle, or 0 on failure.
+uint32_t core_il2cpp_keep_alive(void* object);
+// Lets the GC collect an object kept alive by core_il2cpp_keep_alive again
+void core_il2cpp_release(uint32_t handle);
+
+// Offsets found by signature are cached here, for every mod, keyed by the libil2cpp.so build id
+#define CORE_OFFSET_CACHE_FILE "/sdcard/Android/data/com.beatgames.beatsaber/files/mods/QuestHookOffsets.cache"
+
+// Resolves the signatures against the loaded libil2cpp.so, using and updating CORE_OFFSET_CACHE_FILE.
+// A signature's offset is only valid when its matches is 1, keep the hard-coded offset as a fallback:
+//     if (core_resolve_signatures(signatures, count) >= 0 && signatures[0].matches == 1) {
+//         addr_ScoreController_LateUpdate = signatures[0].offset;
+//     }
+//     INSTALL_HOOK(ScoreController_LateUpdate);
+// Returns the number found exactly once, or -1 if the library is not loaded.
+int core_resolve_signatures(sigscan_signature_t* signatures, int count);
+
+#ifndef CORE_BUILD
+#undef INSTALL_HOOK
+#define INSTALL_HOOK(name) core_install_hook(#name, addr_ ## name, (void*)hook_ ## name, (void**)&name)
+#define getRealOffset(offset) core_real_offset(offset)
+#endif
+
+#endif /* CORE_H */
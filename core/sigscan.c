@@ -0,0 +1,486 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sigscan.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SIGSCAN_NEON
+// Bits per byte in the filter mask
+#define SIGSCAN_FILTER_BITS 4
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define SIGSCAN_SSE2
+#define SIGSCAN_FILTER_BITS 1
+#endif
+
+#define SIGSCAN_MAX_SEGMENTS 16
+#define SIGSCAN_PT_LOAD 1
+#define SIGSCAN_PT_NOTE 4
+#define SIGSCAN_PF_X 1
+#define SIGSCAN_NT_GNU_BUILD_ID 3
+// The anchor histogram is taken from this many evenly spread slices of the text
+#define SIGSCAN_SAMPLE_SLICES 64
+#define SIGSCAN_SAMPLE_SLICE_SIZE 4096
+
+typedef struct sigscan_segment {
+    uint32_t type;
+    uint32_t flags;
+    uint64_t offset;
+    uint64_t vaddr;
+    uint64_t filesz;
+} sigscan_segment_t;
+
+typedef struct sigscan_pattern {
+    uint8_t bytes[SIGSCAN_MAX_PATTERN];
+    // 0xFF for bytes that must match, 0x00 for wildcards
+    uint8_t mask[SIGSCAN_MAX_PATTERN];
+    int len;
+    // Index of the byte the filter looks for
+    int anchor;
+} sigscan_pattern_t;
+
+static uint64_t sigscan_read(const uint8_t* p, int size) {
+    uint64_t value = 0;
+    // ELF files on every platform we care about are little endian
+    for (int i = size - 1; i >= 0; i--) {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+// Reads the program headers, returns the number of segments or -1 if the image is not an ELF
+static int sigscan_segments(const sigscan_image_t* image, sigscan_segment_t* segments, int max) {
+    const uint8_t* data = image->data;
+    if (image->size < 0x40 || memcmp(data, "\x7f" "ELF", 4) != 0 || data[5] != 1) {
+        return -1;
+    }
+    char is64 = data[4] == 2;
+    if (!is64 && data[4] != 1) {
+        return -1;
+    }
+    uint64_t phoff = is64 ? sigscan_read(data + 0x20, 8) : sigscan_read(data + 0x1C, 4);
+    uint64_t phentsize = sigscan_read(data + (is64 ? 0x36 : 0x2A), 2);
+    uint64_t phnum = sigscan_read(data + (is64 ? 0x38 : 0x2C), 2);
+    if (phentsize < (is64 ? 56u : 32u) || phoff + phnum * phentsize > image->size) {
+        return -1;
+    }
+    int count = 0;
+    for (uint64_t i = 0; i < phnum && count < max; i++) {
+        const uint8_t* ph = data + phoff + i * phentsize;
+        sigscan_segment_t* segment = &segments[count++];
+        segment->type = (uint32_t)sigscan_read(ph, 4);
+        if (is64) {
+            segment->flags = (uint32_t)sigscan_read(ph + 4, 4);
+            segment->offset = sigscan_read(ph + 8, 8);
+            segment->vaddr = sigscan_read(ph + 16, 8);
+            segment->filesz = sigscan_read(ph + 32, 8);
+        } else {
+            segment->offset = sigscan_read(ph + 4, 4);
+            segment->vaddr = sigscan_read(ph + 8, 4);
+            segment->filesz = sigscan_read(ph + 16, 4);
+            segment->flags = (uint32_t)sigscan_read(ph + 24, 4);
+        }
+    }
+    return count;
+}
+
+// Where the segment's bytes are in the image, NULL if they are outside of it
+static const uint8_t* sigscan_segment_data(const sigscan_image_t* image, const sigscan_segment_t* segment) {
+    uint64_t start = image->mapped ? segment->vaddr : segment->offset;
+    if (start > image->size || segment->filesz > image->size - start) {
+        return NULL;
+    }
+    return image->data + start;
+}
+
+int sigscan_build_id(const sigscan_image_t* image, char* build_id, int size) {
+    sigscan_segment_t segments[SIGSCAN_MAX_SEGMENTS];
+    int count = sigscan_segments(image, segments, SIGSCAN_MAX_SEGMENTS);
+    for (int i = 0; i < count; i++) {
+        if (segments[i].type != SIGSCAN_PT_NOTE) {
+            continue;
+        }
+        const uint8_t* note = sigscan_segment_data(image, &segments[i]);
+        if (!note) {
+            continue;
+        }
+        uint64_t pos = 0;
+        while (pos + 12 <= segments[i].filesz) {
+            uint32_t namesz = (uint32_t)sigscan_read(note + pos, 4);
+            uint32_t descsz = (uint32_t)sigscan_read(note + pos + 4, 4);
+            uint32_t type = (uint32_t)sigscan_read(note + pos + 8, 4);
+            uint64_t name = pos + 12;
+            uint64_t desc = name + ((namesz + 3) & ~3u);
+            uint64_t next = desc + ((descsz + 3) & ~3u);
+            if (next > segments[i].filesz) {
+                break;
+            }
+            if (type == SIGSCAN_NT_GNU_BUILD_ID && namesz == 4 && memcmp(note + name, "GNU", 4) == 0) {
+                if ((int)descsz * 2 + 1 > size || descsz == 0) {
+                    return -1;
+                }
+                for (uint32_t j = 0; j < descsz; j++) {
+                    sprintf(build_id + j * 2, "%02x", note[desc + j]);
+                }
+                return 0;
+            }
+            pos = next;
+        }
+    }
+    return -1;
+}
+
+static int sigscan_hex(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+// Parses "2D E9 ?? 4F", returns 0 on success
+static int sigscan_compile(const char* text, sigscan_pattern_t* pattern) {
+    memset(pattern, 0, sizeof(*pattern));
+    char concrete = '\0';
+    const char* p = text;
+    while (*p) {
+        if (*p == ' ') {
+            p++;
+            continue;
+        }
+        if (pattern->len == SIGSCAN_MAX_PATTERN) {
+            return -1;
+        }
+        if (*p == '?') {
+            p += p[1] == '?' ? 2 : 1;
+            pattern->len++;
+            continue;
+        }
+        int high = sigscan_hex(p[0]);
+        int low = high >= 0 ? sigscan_hex(p[1]) : -1;
+        if (low < 0) {
+            return -1;
+        }
+        pattern->bytes[pattern->len] = (uint8_t)(high << 4 | low);
+        pattern->mask[pattern->len] = 0xFF;
+        pattern->len++;
+        concrete = '\1';
+        p += 2;
+    }
+    return concrete ? 0 : -1;
+}
+
+static void sigscan_histogram(const sigscan_image_t* image, const sigscan_segment_t* segments, int count, uint32_t* histogram) {
+    for (int i = 0; i < count; i++) {
+        const uint8_t* data = sigscan_segment_data(image, &segments[i]);
+        uint64_t len = segments[i].filesz;
+        uint64_t step = len / SIGSCAN_SAMPLE_SLICES;
+        if (step < SIGSCAN_SAMPLE_SLICE_SIZE) {
+            // Small enough to count all of it
+            for (uint64_t j = 0; j < len; j++) {
+                histogram[data[j]]++;
+            }
+            continue;
+        }
+        for (int slice = 0; slice < SIGSCAN_SAMPLE_SLICES; slice++) {
+            const uint8_t* p = data + slice * step;
+            for (int j = 0; j < SIGSCAN_SAMPLE_SLICE_SIZE; j++) {
+                histogram[p[j]]++;
+            }
+        }
+    }
+}
+
+static inline char sigscan_match(const uint8_t* p, const sigscan_pattern_t* pattern) {
+    for (int i = 0; i < pattern->len; i++) {
+        if ((p[i] & pattern->mask[i]) != pattern->bytes[i]) {
+            return '\0';
+        }
+    }
+    return '\1';
+}
+
+typedef struct sigscan_state {
+    sigscan_signature_t* signatures;
+    sigscan_pattern_t* patterns;
+    // Signatures grouped by anchor byte: order[bucket[b]] .. order[bucket[b + 1] - 1]
+    int bucket[257];
+    int* order;
+} sigscan_state_t;
+
+// Checks every signature anchored on the byte at `pos` of the segment
+static inline void sigscan_candidate(sigscan_state_t* state, const uint8_t* data, uint64_t len, uint64_t vaddr, uint64_t pos) {
+    uint8_t b = data[pos];
+    for (int k = state->bucket[b]; k < state->bucket[b + 1]; k++) {
+        int index = state->order[k];
+        const sigscan_pattern_t* pattern = &state->patterns[index];
+        if (pos < (uint64_t)pattern->anchor) {
+            continue;
+        }
+        uint64_t start = pos - pattern->anchor;
+        if (start + pattern->len > len || !sigscan_match(data + start, pattern)) {
+            continue;
+        }
+        sigscan_signature_t* signature = &state->signatures[index];
+        if (signature->matches == 0) {
+            signature->offset = (int64_t)(vaddr + start) + signature->adjust;
+        }
+        if (signature->matches < SIGSCAN_MAX_MATCHES) {
+            signature->matches++;
+        }
+    }
+}
+
+static void sigscan_segment(sigscan_state_t* state, const uint8_t* data, uint64_t len, uint64_t vaddr, const uint8_t* anchors, int anchor_count) {
+    uint64_t pos = 0;
+#ifdef SIGSCAN_FILTER_BITS
+    if (anchor_count <= SIGSCAN_SIMD_ANCHORS) {
+        for (; pos + 16 <= len; pos += 16) {
+            uint64_t mask;
+#ifdef SIGSCAN_NEON
+            uint8x16_t v = vld1q_u8(data + pos);
+            uint8x16_t hits = vdupq_n_u8(0);
+            for (int j = 0; j < anchor_count; j++) {
+                hits = vorrq_u8(hits, vceqq_u8(v, vdupq_n_u8(anchors[j])));
+            }
+            // Narrow to a nibble per byte, NEON has no movemask
+            mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(hits), 4)), 0);
+#else
+            __m128i v = _mm_loadu_si128((const __m128i*)(data + pos));
+            __m128i hits = _mm_setzero_si128();
+            for (int j = 0; j < anchor_count; j++) {
+                hits = _mm_or_si128(hits, _mm_cmpeq_epi8(v, _mm_set1_epi8((char)anchors[j])));
+            }
+            mask = (uint64_t)_mm_movemask_epi8(hits);
+#endif
+            while (mask) {
+                int byte = __builtin_ctzll(mask) / SIGSCAN_FILTER_BITS;
+                sigscan_candidate(state, data, len, vaddr, pos + byte);
+                mask &= ~(((1ull << SIGSCAN_FILTER_BITS) - 1) << (byte * SIGSCAN_FILTER_BITS));
+            }
+        }
+    }
+#endif
+    for (; pos < len; pos++) {
+        uint8_t b = data[pos];
+        if (state->bucket[b] != state->bucket[b + 1]) {
+            sigscan_candidate(state, data, len, vaddr, pos);
+        }
+    }
+}
+
+int sigscan_scan(const sigscan_image_t* image, sigscan_signature_t* signatures, int count) {
+    sigscan_segment_t all[SIGSCAN_MAX_SEGMENTS];
+    sigscan_segment_t segments[SIGSCAN_MAX_SEGMENTS];
+    int all_count = sigscan_segments(image, all, SIGSCAN_MAX_SEGMENTS);
+    if (all_count < 0) {
+        return -1;
+    }
+    int segment_count = 0;
+    for (int i = 0; i < all_count; i++) {
+        if (all[i].type == SIGSCAN_PT_LOAD && (all[i].flags & SIGSCAN_PF_X) && sigscan_segment_data(image, &all[i])) {
+            segments[segment_count++] = all[i];
+        }
+    }
+    sigscan_state_t state;
+    state.signatures = signatures;
+    state.patterns = malloc(count * sizeof(sigscan_pattern_t));
+    state.order = malloc(count * sizeof(int));
+    if (!state.patterns || !state.order) {
+        free(state.patterns);
+        free(state.order);
+        return -1;
+    }
+    for (int i = 0; i < count; i++) {
+        signatures[i].offset = -1;
+        signatures[i].matches = 0;
+        if (sigscan_compile(signatures[i].pattern, &state.patterns[i]) != 0) {
+            free(state.patterns);
+            free(state.order);
+            return -1;
+        }
+    }
+
+    // Anchor every signature on its rarest byte
+    uint32_t histogram[256] = { 0 };
+    sigscan_histogram(image, segments, segment_count, histogram);
+    int anchor_counts[256] = { 0 };
+    for (int i = 0; i < count; i++) {
+        sigscan_pattern_t* pattern = &state.patterns[i];
+        pattern->anchor = -1;
+        for (int j = 0; j < pattern->len; j++) {
+            if (pattern->mask[j] && (pattern->anchor < 0 || histogram[pattern->bytes[j]] < histogram[pattern->bytes[pattern->anchor]])) {
+                pattern->anchor = j;
+            }
+        }
+        anchor_counts[pattern->bytes[pattern->anchor]]++;
+    }
+    uint8_t anchors[256];
+    int anchor_count = 0;
+    state.bucket[0] = 0;
+    for (int b = 0; b < 256; b++) {
+        state.bucket[b + 1] = state.bucket[b] + anchor_counts[b];
+        if (anchor_counts[b] > 0) {
+            anchors[anchor_count++] = (uint8_t)b;
+        }
+    }
+    int fill[256];
+    memcpy(fill, state.bucket, sizeof(fill));
+    for (int i = 0; i < count; i++) {
+        state.order[fill[state.patterns[i].bytes[state.patterns[i].anchor]]++] = i;
+    }
+
+    for (int i = 0; i < segment_count; i++) {
+        sigscan_segment(&state, sigscan_segment_data(image, &segments[i]), segments[i].filesz, segments[i].vaddr, anchors, anchor_count);
+    }
+    free(state.patterns);
+    free(state.order);
+    int found = 0;
+    for (int i = 0; i < count; i++) {
+        found += signatures[i].matches == 1;
+    }
+    return found;
+}
+
+// Identifies a signature in the cache, so an edited pattern is scanned for again
+static uint32_t sigscan_hash(const sigscan_signature_t* signature) {
+    uint32_t hash = 2166136261u;
+    for (const char* p = signature->pattern; *p; p++) {
+        hash = (hash ^ (uint8_t)*p) * 16777619u;
+    }
+    return (hash ^ (uint32_t)signature->adjust) * 16777619u;
+}
+
+// Opens the cache and checks its build id line, NULL if it is missing or for another build
+static FILE* sigscan_cache_open(const char* path, const char* build_id) {
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        return NULL;
+    }
+    char line[128];
+    char id[SIGSCAN_BUILD_ID_SIZE];
+    if (!fgets(line, sizeof(line), f) || sscanf(line, "build-id %64s", id) != 1 || strcmp(id, build_id) != 0) {
+        fclose(f);
+        return NULL;
+    }
+    return f;
+}
+
+int sigscan_cache_load(const char* path, const char* build_id, sigscan_signature_t* signatures, int count, char* found) {
+    FILE* f = sigscan_cache_open(path, build_id);
+    if (!f) {
+        return 0;
+    }
+    int loaded = 0;
+    char line[512];
+    char name[256];
+    unsigned int hash;
+    long long offset;
+    int matches;
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "%255s %x %lld %d", name, &hash, &offset, &matches) != 4) {
+            continue;
+        }
+        for (int i = 0; i < count; i++) {
+            if (!found[i] && strcmp(signatures[i].name, name) == 0 && sigscan_hash(&signatures[i]) == hash) {
+                signatures[i].offset = offset;
+                signatures[i].matches = matches;
+                found[i] = '\1';
+                loaded++;
+                break;
+            }
+        }
+    }
+    fclose(f);
+    return loaded;
+}
+
+int sigscan_cache_save(const char* path, const char* build_id, const sigscan_signature_t* signatures, int count) {
+    char temp[1024];
+    snprintf(temp, sizeof(temp), "%s.tmp", path);
+    FILE* out = fopen(temp, "w");
+    if (!out) {
+        return -1;
+    }
+    fprintf(out, "build-id %s\n", build_id);
+    // Keep the entries of other mods' signatures for the same build
+    FILE* in = sigscan_cache_open(path, build_id);
+    if (in) {
+        char line[512];
+        char name[256];
+        while (fgets(line, sizeof(line), in)) {
+            if (sscanf(line, "%255s", name) != 1) {
+                continue;
+            }
+            char ours = '\0';
+            for (int i = 0; i < count && !ours; i++) {
+                ours = strcmp(signatures[i].name, name) == 0;
+            }
+            if (!ours) {
+                fputs(line, out);
+            }
+        }
+        fclose(in);
+    }
+    for (int i = 0; i < count; i++) {
+        fprintf(out, "%s %08x %lld %d\n", signatures[i].name, sigscan_hash(&signatures[i]), (long long)signatures[i].offset, signatures[i].matches);
+    }
+    if (fclose(out) != 0 || rename(temp, path) != 0) {
+        remove(temp);
+        return -1;
+    }
+    return 0;
+}
+
+int sigscan_resolve(const sigscan_image_t* image, const char* cache_path, sigscan_signature_t* signatures, int count) {
+    char build_id[SIGSCAN_BUILD_ID_SIZE];
+    if (cache_path && sigscan_build_id(image, build_id, sizeof(build_id)) != 0) {
+        // Without a build id a cached offset could be for another version of the game
+        cache_path = NULL;
+    }
+    char* found = calloc(count, 1);
+    sigscan_signature_t* missing = malloc(count * sizeof(sigscan_signature_t));
+    if (!found || !missing) {
+        free(found);
+        free(missing);
+        return -1;
+    }
+    int loaded = cache_path ? sigscan_cache_load(cache_path, build_id, signatures, count, found) : 0;
+    int r = 0;
+    if (loaded < count) {
+        int missing_count = 0;
+        for (int i = 0; i < count; i++) {
+            if (!found[i]) {
+                missing[missing_count++] = signatures[i];
+            }
+        }
+        r = sigscan_scan(image, missing, missing_count);
+        if (r >= 0) {
+            for (int i = 0, j = 0; i < count; i++) {
+                if (!found[i]) {
+                    signatures[i] = missing[j++];
+                }
+            }
+            if (cache_path) {
+                sigscan_cache_save(cache_path, build_id, signatures, count);
+            }
+        }
+    }
+    free(found);
+    free(missing);
+    if (r < 0) {
+        return -1;
+    }
+    int resolved = 0;
+    for (int i = 0; i < count; i++) {
+        resolved += signatures[i].matches == 1;
+    }
+    return resolved;
+}
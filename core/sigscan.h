@@ -0,0 +1,56 @@
+#ifndef SIGSCAN_H
+#define SIGSCAN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Finds methods in libil2cpp.so by byte signatures instead of hard-coded offsets.
+// A signature is a string of hex bytes and wildcards, e.g. "2D E9 F0 4F ?? ?? 9F E5". Every signature is
+// looked for in all executable segments in a single pass. The pass picks an anchor byte per signature (the
+// rarest of its bytes in the library), filters 16 bytes at a time against all anchors with SIMD (NEON on
+// the Quest, SSE2 on x86 hosts), and only compares whole signatures where an anchor matched.
+// Results can be cached in a text file keyed by the library's ELF build id, so they are scanned for once
+// per game version. Nothing here depends on Android, the same code runs on host against ELF files.
+
+// Longest signature, in bytes
+#define SIGSCAN_MAX_PATTERN 64
+// Most matches counted per signature
+#define SIGSCAN_MAX_MATCHES 16
+// Most distinct anchor bytes the SIMD filter handles, more fall back to a table lookup per byte
+#define SIGSCAN_SIMD_ANCHORS 16
+// Longest build id, as hex
+#define SIGSCAN_BUILD_ID_SIZE 65
+
+typedef struct sigscan_signature {
+    const char* name;
+    const char* pattern;
+    // Added to the start of the match, for signatures that begin inside the method
+    int adjust;
+    // Results: offset from the library base (what getRealOffset takes), or -1 if not found.
+    // Only use the offset when matches is 1.
+    int64_t offset;
+    int matches;
+} sigscan_signature_t;
+
+// An ELF image, either a file read into memory or a library as the dynamic linker mapped it
+typedef struct sigscan_image {
+    const uint8_t* data;
+    size_t size;
+    // Segments are at data + p_vaddr instead of data + p_offset
+    char mapped;
+} sigscan_image_t;
+
+// Writes the GNU build id as lowercase hex. Returns 0 on success, -1 if the image has none.
+int sigscan_build_id(const sigscan_image_t* image, char* build_id, int size);
+// Scans the executable segments of the image for every signature. Returns the number found exactly once,
+// or -1 if the image is not a valid ELF or a pattern does not parse.
+int sigscan_scan(const sigscan_image_t* image, sigscan_signature_t* signatures, int count);
+// Fills in the signatures found in the cache for this build id. Returns how many were found.
+int sigscan_cache_load(const char* path, const char* build_id, sigscan_signature_t* signatures, int count, char* found);
+// Adds the signatures to the cache, keeping the entries of other signatures with the same build id.
+int sigscan_cache_save(const char* path, const char* build_id, const sigscan_signature_t* signatures, int count);
+// Loads what it can from the cache, scans for the rest in one pass and saves them.
+// cache_path may be NULL to always scan. Returns the number found exactly once, or -1 on error.
+int sigscan_resolve(const sigscan_image_t* image, const char* cache_path, sigscan_signature_t* signatures, int count);
+
+#endif /* SIGSCAN_H */
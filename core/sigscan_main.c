@@ -0,0 +1,118 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "sigscan.h"
+
+// Resolves signatures against a libil2cpp.so pulled from the Quest (or any ELF file), the same way the core
+// does at load time. Use it to check that a new signature matches exactly once before shipping it.
+// The signature file has one signature per line: name adjust pattern, e.g.
+//     ScoreController_LateUpdate 0 2D E9 F0 4F ?? ?? 9F E5
+// Lines starting with # are ignored.
+
+#define MAX_SIGNATURES 1024
+
+static void usage(const char* name) {
+    fprintf(stderr, "Usage: %s [-c cache] libil2cpp.so signatures.txt\n", name);
+}
+
+static double now_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint8_t* read_file(const char* path, size_t* size) {
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t* data = len > 0 ? malloc(len) : NULL;
+    if (data && fread(data, 1, len, f) != (size_t)len) {
+        free(data);
+        data = NULL;
+    }
+    fclose(f);
+    *size = len;
+    return data;
+}
+
+static int read_signatures(const char* path, sigscan_signature_t* signatures, int max) {
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        return -1;
+    }
+    int count = 0;
+    char line[512];
+    while (fgets(line, sizeof(line), f) && count < max) {
+        line[strcspn(line, "\r\n")] = '\0';
+        char name[256];
+        int adjust;
+        int pattern_start;
+        if (line[0] == '#' || sscanf(line, "%255s %i %n", name, &adjust, &pattern_start) != 2) {
+            continue;
+        }
+        signatures[count].name = strdup(name);
+        signatures[count].pattern = strdup(line + pattern_start);
+        signatures[count].adjust = adjust;
+        count++;
+    }
+    fclose(f);
+    return count;
+}
+
+int main(int argc, char** argv) {
+    const char* cache = NULL;
+    int opt;
+    while ((opt = getopt(argc, argv, "c:h")) != -1) {
+        switch (opt) {
+        case 'c':
+            cache = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (argc - optind != 2) {
+        usage(argv[0]);
+        return 1;
+    }
+    sigscan_image_t image;
+    image.mapped = '\0';
+    image.data = read_file(argv[optind], &image.size);
+    if (!image.data) {
+        fprintf(stderr, "Could not read %s\n", argv[optind]);
+        return 1;
+    }
+    static sigscan_signature_t signatures[MAX_SIGNATURES];
+    int count = read_signatures(argv[optind + 1], signatures, MAX_SIGNATURES);
+    if (count < 0) {
+        fprintf(stderr, "Could not read %s\n", argv[optind + 1]);
+        return 1;
+    }
+
+    char build_id[SIGSCAN_BUILD_ID_SIZE];
+    printf("build id: %s\n", sigscan_build_id(&image, build_id, sizeof(build_id)) == 0 ? build_id : "(none)");
+    double start = now_seconds();
+    int found = sigscan_resolve(&image, cache, signatures, count);
+    double elapsed = now_seconds() - start;
+    if (found < 0) {
+        fprintf(stderr, "Not a valid ELF file or a pattern does not parse\n");
+        return 1;
+    }
+    for (int i = 0; i < count; i++) {
+        if (signatures[i].matches == 1) {
+            printf("%-60s 0x%llX\n", signatures[i].name, (long long)signatures[i].offset);
+        } else {
+            printf("%-60s %s (%i matches)\n", signatures[i].name, signatures[i].matches ? "ambiguous" : "not found", signatures[i].matches);
+        }
+    }
+    printf("%i of %i signatures resolved in %.2f ms (%.1f MB)\n", found, count, elapsed * 1000, image.size / 1e6);
+    return found == count ? 0 : 2;
+}
@@ -0,0 +1,241 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "sigscan.h"
+
+// Host test for the signature scanner: builds small ELF images in memory with known byte patterns and
+// checks what sigscan_resolve finds in them, with and without the build id cache. Run with `make test`.
+
+#define TEXT_OFFSET 0x1000
+#define TEXT_VADDR 0x10000
+// Big enough for the SIMD filter, not a multiple of 16 so the scalar tail runs too
+#define TEXT_SIZE 0x10007
+#define DATA_OFFSET (TEXT_OFFSET + TEXT_SIZE)
+#define DATA_VADDR 0x30000
+#define DATA_SIZE 0x100
+#define NOTE_OFFSET (DATA_OFFSET + DATA_SIZE)
+#define NOTE_VADDR 0x28000
+#define NOTE_SIZE (12 + 4 + 20)
+#define IMAGE_SIZE (NOTE_OFFSET + NOTE_SIZE)
+// Where the segments are once loaded, for images laid out like a mapped library
+#define MAPPED_SIZE (DATA_VADDR + DATA_SIZE)
+
+// Where the test patterns are put in the text segment
+#define UNIQUE_AT 0x123
+#define AMBIGUOUS_AT_1 0x2000
+#define AMBIGUOUS_AT_2 0x8001
+#define WILDCARD_AT 0x4567
+#define WILDCARD_NEAR_MISS_AT 0x5000
+#define TAIL_AT (TEXT_SIZE - 5)
+
+static int failures = 0;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { \
+        printf("FAIL %s:%i: ", __FILE__, __LINE__); \
+        printf(__VA_ARGS__); \
+        printf("\n"); \
+        failures++; \
+    } \
+} while (0)
+
+static void write_le(uint8_t* p, uint64_t value, int size) {
+    for (int i = 0; i < size; i++) {
+        p[i] = (uint8_t)(value >> (i * 8));
+    }
+}
+
+static void put_bytes(uint8_t* p, const char* hex) {
+    for (int i = 0; *hex; i++) {
+        p[i] = (uint8_t)strtoul(hex, (char**)&hex, 16);
+    }
+}
+
+static void write_segment(uint8_t* ph, char is64, uint32_t type, uint32_t flags, uint64_t offset, uint64_t vaddr, uint64_t size) {
+    write_le(ph, type, 4);
+    if (is64) {
+        write_le(ph + 4, flags, 4);
+        write_le(ph + 8, offset, 8);
+        write_le(ph + 16, vaddr, 8);
+        write_le(ph + 24, vaddr, 8);
+        write_le(ph + 32, size, 8);
+        write_le(ph + 40, size, 8);
+    } else {
+        write_le(ph + 4, offset, 4);
+        write_le(ph + 8, vaddr, 4);
+        write_le(ph + 12, vaddr, 4);
+        write_le(ph + 16, size, 4);
+        write_le(ph + 20, size, 4);
+        write_le(ph + 24, flags, 4);
+    }
+}
+
+// An ELF file with an executable text segment, a data segment and a build id note.
+// The text is filler from 0x10..0x1F, so only the planted patterns can match.
+static uint8_t* build_image(char is64, uint8_t build_id_seed) {
+    uint8_t* data = calloc(1, IMAGE_SIZE);
+    memcpy(data, "\x7f" "ELF", 4);
+    data[4] = is64 ? 2 : 1;
+    data[5] = 1;
+    data[6] = 1;
+    uint64_t phoff = is64 ? 0x40 : 0x34;
+    int phentsize = is64 ? 56 : 32;
+    if (is64) {
+        write_le(data + 0x20, phoff, 8);
+        write_le(data + 0x36, phentsize, 2);
+        write_le(data + 0x38, 3, 2);
+    } else {
+        write_le(data + 0x1C, phoff, 4);
+        write_le(data + 0x2A, phentsize, 2);
+        write_le(data + 0x2C, 3, 2);
+    }
+    // PT_LOAD R+X, PT_LOAD R+W, PT_NOTE
+    write_segment(data + phoff, is64, 1, 5, TEXT_OFFSET, TEXT_VADDR, TEXT_SIZE);
+    write_segment(data + phoff + phentsize, is64, 1, 6, DATA_OFFSET, DATA_VADDR, DATA_SIZE);
+    write_segment(data + phoff + 2 * phentsize, is64, 4, 4, NOTE_OFFSET, NOTE_VADDR, NOTE_SIZE);
+
+    uint8_t* text = data + TEXT_OFFSET;
+    for (int i = 0; i < TEXT_SIZE; i++) {
+        text[i] = (uint8_t)(0x10 + (i * 7 & 15));
+    }
+    put_bytes(text + UNIQUE_AT, "2D E9 F0 4F A1 B2");
+    put_bytes(text + AMBIGUOUS_AT_1, "C3 D4 E5 F6");
+    put_bytes(text + AMBIGUOUS_AT_2, "C3 D4 E5 F6");
+    put_bytes(text + WILDCARD_AT, "9A 77 88 BC DE");
+    put_bytes(text + WILDCARD_NEAR_MISS_AT, "9A 77 88 BC DF");
+    put_bytes(text + TAIL_AT, "E1 2F FF 1E 99");
+    // Only in the data segment, which is not executable and must not be scanned
+    put_bytes(data + DATA_OFFSET + 0x10, "AB CD EF 99");
+
+    uint8_t* note = data + NOTE_OFFSET;
+    write_le(note, 4, 4);
+    write_le(note + 4, 20, 4);
+    write_le(note + 8, 3, 4);
+    memcpy(note + 12, "GNU", 4);
+    for (int i = 0; i < 20; i++) {
+        note[16 + i] = (uint8_t)(build_id_seed + i);
+    }
+    return data;
+}
+
+// The same image as the dynamic linker would map it, segments at their vaddr
+static uint8_t* map_image(const uint8_t* file) {
+    uint8_t* mapped = calloc(1, MAPPED_SIZE);
+    memcpy(mapped, file, 0x100);
+    memcpy(mapped + TEXT_VADDR, file + TEXT_OFFSET, TEXT_SIZE);
+    memcpy(mapped + DATA_VADDR, file + DATA_OFFSET, DATA_SIZE);
+    memcpy(mapped + NOTE_VADDR, file + NOTE_OFFSET, NOTE_SIZE);
+    return mapped;
+}
+
+enum { UNIQUE, ADJUSTED, AMBIGUOUS, MISS, WILDCARD, TAIL, SIGNATURE_COUNT };
+
+static void init_signatures(sigscan_signature_t* signatures) {
+    memset(signatures, 0, SIGNATURE_COUNT * sizeof(sigscan_signature_t));
+    signatures[UNIQUE] = (sigscan_signature_t){ "Unique", "2D E9 F0 4F A1 B2", 0, 0, 0 };
+    signatures[ADJUSTED] = (sigscan_signature_t){ "Adjusted", "F0 4F A1 B2", -2, 0, 0 };
+    signatures[AMBIGUOUS] = (sigscan_signature_t){ "Ambiguous", "C3 D4 E5 F6", 0, 0, 0 };
+    signatures[MISS] = (sigscan_signature_t){ "Miss", "AB CD EF 99", 0, 0, 0 };
+    signatures[WILDCARD] = (sigscan_signature_t){ "Wildcard", "9A ?? ?? BC DE", 0, 0, 0 };
+    signatures[TAIL] = (sigscan_signature_t){ "Tail", "E1 2F FF 1E 99", 0, 0, 0 };
+}
+
+static void check_found(const sigscan_signature_t* signatures, int found, const char* what) {
+    CHECK(found == 4, "%s: %i resolved, expected 4", what, found);
+    CHECK(signatures[UNIQUE].matches == 1 && signatures[UNIQUE].offset == TEXT_VADDR + UNIQUE_AT,
+        "%s: unique at 0x%llX (%i matches)", what, (long long)signatures[UNIQUE].offset, signatures[UNIQUE].matches);
+    CHECK(signatures[ADJUSTED].matches == 1 && signatures[ADJUSTED].offset == TEXT_VADDR + UNIQUE_AT,
+        "%s: adjusted at 0x%llX (%i matches)", what, (long long)signatures[ADJUSTED].offset, signatures[ADJUSTED].matches);
+    CHECK(signatures[AMBIGUOUS].matches == 2 && signatures[AMBIGUOUS].offset == TEXT_VADDR + AMBIGUOUS_AT_1,
+        "%s: ambiguous at 0x%llX (%i matches)", what, (long long)signatures[AMBIGUOUS].offset, signatures[AMBIGUOUS].matches);
+    CHECK(signatures[MISS].matches == 0 && signatures[MISS].offset == -1,
+        "%s: miss at 0x%llX (%i matches)", what, (long long)signatures[MISS].offset, signatures[MISS].matches);
+    CHECK(signatures[WILDCARD].matches == 1 && signatures[WILDCARD].offset == TEXT_VADDR + WILDCARD_AT,
+        "%s: wildcard at 0x%llX (%i matches)", what, (long long)signatures[WILDCARD].offset, signatures[WILDCARD].matches);
+    CHECK(signatures[TAIL].matches == 1 && signatures[TAIL].offset == TEXT_VADDR + TAIL_AT,
+        "%s: tail at 0x%llX (%i matches)", what, (long long)signatures[TAIL].offset, signatures[TAIL].matches);
+}
+
+static void test_scan(char is64) {
+    const char* what = is64 ? "ELF64" : "ELF32";
+    uint8_t* file = build_image(is64, 0x40);
+    sigscan_signature_t signatures[SIGNATURE_COUNT];
+    init_signatures(signatures);
+    sigscan_image_t image = { file, IMAGE_SIZE, '\0' };
+    check_found(signatures, sigscan_resolve(&image, NULL, signatures, SIGNATURE_COUNT), what);
+
+    uint8_t* mapped = map_image(file);
+    init_signatures(signatures);
+    sigscan_image_t mapped_image = { mapped, MAPPED_SIZE, '\1' };
+    check_found(signatures, sigscan_resolve(&mapped_image, NULL, signatures, SIGNATURE_COUNT), is64 ? "ELF64 mapped" : "ELF32 mapped");
+
+    char build_id[SIGSCAN_BUILD_ID_SIZE];
+    CHECK(sigscan_build_id(&image, build_id, sizeof(build_id)) == 0 && strcmp(build_id, "404142434445464748494a4b4c4d4e4f50515253") == 0,
+        "%s: build id %s", what, build_id);
+
+    sigscan_signature_t bad = { "Bad", "2D E9 G0", 0, 0, 0 };
+    CHECK(sigscan_scan(&image, &bad, 1) == -1, "%s: a pattern that does not parse is not an error", what);
+    sigscan_signature_t wildcards = { "Wildcards", "?? ??", 0, 0, 0 };
+    CHECK(sigscan_scan(&image, &wildcards, 1) == -1, "%s: a pattern with only wildcards is not an error", what);
+    free(mapped);
+    free(file);
+}
+
+static void test_cache() {
+    char cache[64];
+    snprintf(cache, sizeof(cache), "/tmp/sigscan_test_%i.cache", (int)getpid());
+    remove(cache);
+    uint8_t* file = build_image('\0', 0x40);
+    sigscan_image_t image = { file, IMAGE_SIZE, '\0' };
+    sigscan_signature_t signatures[SIGNATURE_COUNT];
+    init_signatures(signatures);
+    check_found(signatures, sigscan_resolve(&image, cache, signatures, SIGNATURE_COUNT), "first scan");
+
+    // Breaking the unique pattern does not change the build id, so the cached offset is still used
+    memset(file + TEXT_OFFSET + UNIQUE_AT, 0x10, 2);
+    init_signatures(signatures);
+    check_found(signatures, sigscan_resolve(&image, cache, signatures, SIGNATURE_COUNT), "cached");
+
+    // A new build id makes the whole cache stale, so everything is scanned for again
+    free(file);
+    file = build_image('\0', 0x80);
+    image.data = file;
+    memset(file + TEXT_OFFSET + UNIQUE_AT, 0x10, 2);
+    init_signatures(signatures);
+    int found = sigscan_resolve(&image, cache, signatures, SIGNATURE_COUNT);
+    CHECK(found == 3, "stale cache: %i resolved, expected 3", found);
+    CHECK(signatures[UNIQUE].matches == 0 && signatures[UNIQUE].offset == -1,
+        "stale cache: unique at 0x%llX (%i matches), the stale entry was used", (long long)signatures[UNIQUE].offset, signatures[UNIQUE].matches);
+
+    FILE* f = fopen(cache, "r");
+    char line[128] = "";
+    CHECK(f && fgets(line, sizeof(line), f) && strcmp(line, "build-id 808182838485868788898a8b8c8d8e8f90919293\n") == 0,
+        "stale cache: not rewritten for the new build id, first line %s", line);
+    if (f) {
+        fclose(f);
+    }
+
+    // The cache now says Unique is not there. An edited pattern is scanned for, not taken from the cache.
+    put_bytes(file + TEXT_OFFSET + UNIQUE_AT, "2D E9");
+    init_signatures(signatures);
+    signatures[UNIQUE].pattern = "2D E9 F0 4F ?? B2";
+    sigscan_resolve(&image, cache, signatures, SIGNATURE_COUNT);
+    CHECK(signatures[UNIQUE].matches == 1 && signatures[UNIQUE].offset == TEXT_VADDR + UNIQUE_AT,
+        "edited pattern: unique at 0x%llX (%i matches), the old entry was used", (long long)signatures[UNIQUE].offset, signatures[UNIQUE].matches);
+    remove(cache);
+    free(file);
+}
+
+int main() {
+    test_scan('\0');
+    test_scan('\1');
+    test_cache();
+    if (failures > 0) {
+        printf("%i checks failed\n", failures);
+        return 1;
+    }
+    printf("All sigscan tests passed\n");
+    return 0;
+}
@@ -1,5 +1,9 @@
 #!/bin/bash
 set -e
+(cd ../core && ndk-build NDK_PROJECT_PATH=. APP_BUILD_SCRIPT=./Android.mk NDK_APPLICATION_MK=./Application.mk)
+adb push ../core/libs/armeabi-v7a/lib0questhookcore.so /sdcard/Android/data/com.beatgames.beatsaber/files/mods/lib0questhookcore.so
+# Left over from before the core was renamed to load first
+adb shell rm -f /sdcard/Android/data/com.beatgames.beatsaber/files/mods/libquesthookcore.so /sdcard/Android/data/com.beatgames.beatsaber/files/mods/libgameplayevents.so
 ndk-build NDK_PROJECT_PATH=. APP_BUILD_SCRIPT=./Android.mk NDK_APPLICATION_MK=./Application.mk
 adb push libs/armeabi-v7a/libcustomsabers.so /sdcard/Android/data/com.beatgames.beatsaber/files/mods/libcustomsabers.so
 adb shell am force-stop com.beatgames.beatsaber
@@ -1,4 +1,5 @@
 #include <android/log.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -10,8 +11,8 @@
 #include <sys/sendfile.h>
 #include <sys/stat.h>
 
-#include "../beatsaber-hook/shared/inline-hook/inlineHook.h"
-#include "../beatsaber-hook/shared/utils/utils.h"
+#include "../core/core.h"
+#include "saberlibrary.h"
 
 #undef log
 #define log(...) __android_log_print(ANDROID_LOG_INFO, "QuestHook", "[CustomSabers] " __VA_ARGS__)
@@ -45,27 +46,209 @@
 // Can't find matching calls to these in dumps, they look like locations where DAT are held (pointers to DAT)
 
 
-cs_string PATH = "customSaber.bundle";
-int GO_TYPE = 
+// Used when the saber library is empty
+#define BUNDLE_PATH "/sdcard/Android/data/com.beatgames.beatsaber/files/mods/customSaber.bundle"
+#define SABER_ASSET_NAME "_customsaber"
+// Children of the prefab with the saber for each hand
+#define LEFT_SABER_NAME "LeftSaber"
+#define RIGHT_SABER_NAME "RightSaber"
+
+// AssetBundle.LoadFromFileAsync(string path): 0x1278B44
+#define AssetBundle_LoadFromFileAsync_offset 0x1278B44
+// AssetBundleCreateRequest.get_assetBundle: 0x1278D60
+#define AssetBundleCreateRequest_get_assetBundle_offset 0x1278D60
+// AssetBundle.LoadAssetAsync(string name, Type type): 0x1278B68
+#define AssetBundle_LoadAssetAsync_offset 0x1278B68
+// AssetBundleRequest.get_asset: 0x1278E08
+#define AssetBundleRequest_get_asset_offset 0x1278E08
+// HealthWarningFlowCoordinator.DidActivate: 0x13653C8
+#define HealthWarningFlowCoordinator_DidActivate_offset 0x13653C8
+// MainMenuViewController.DidActivate: 0x12CA338
+#define MainMenuViewController_DidActivate_offset 0x12CA338
+// Saber.get_saberType: 0x480FA0
+#define Saber_get_saberType_offset 0x480FA0
+// Component.get_gameObject: 0xC31C10
+#define Component_get_gameObject_offset 0xC31C10
+
+// SaberType
+#define SABER_TYPE_A 0
+#define SABER_TYPE_B 1
+
+typedef enum saber_cache_state {
+    SABER_CACHE_EMPTY,
+    // LoadFromFileAsync was called, the bundle loads in the background
+    SABER_CACHE_LOADING,
+    SABER_CACHE_READY,
+    SABER_CACHE_FAILED
+} saber_cache_state_t;
+
+// The saber bundle and prefab, loaded once per session. Only touched on the main thread.
+typedef struct saber_cache {
+    saber_cache_state_t state;
+    void* bundle_request;
+    void* bundle;
+    void* prefab;
+    // Child of the prefab to instantiate for each SaberType, both are the whole prefab if it has no
+    // LeftSaber/RightSaber children
+    void* hand_prefabs[2];
+    // Sabers instantiated this session, the prefab is only loaded once
+    int instances;
+} saber_cache_t;
+
+static saber_cache_t saber_cache;
+
+static saber_library_t saber_library;
+// Bundle of the selected saber
+static char bundle_path[PATH_MAX] = BUNDLE_PATH;
+
+// No known offsets, looked up through the il2cpp API with the prefab
+static void* (*Object_Instantiate)(void*) = NULL;
+static void* (*Component_get_transform)(void*) = NULL;
+static void* (*GameObject_get_transform)(void*) = NULL;
+static void (*Transform_SetParent)(void*, void*, char) = NULL;
+static void* (*Transform_Find)(void*, cs_string*) = NULL;
+
+// il2cpp is not set up yet when the mod loads, so this runs on the main menu
+static char resolve_methods() {
+    Object_Instantiate = core_il2cpp_method("UnityEngine.CoreModule", "UnityEngine", "Object", "Instantiate", 1);
+    Component_get_transform = core_il2cpp_method("UnityEngine.CoreModule", "UnityEngine", "Component", "get_transform", 0);
+    GameObject_get_transform = core_il2cpp_method("UnityEngine.CoreModule", "UnityEngine", "GameObject", "get_transform", 0);
+    Transform_SetParent = core_il2cpp_method("UnityEngine.CoreModule", "UnityEngine", "Transform", "SetParent", 2);
+    Transform_Find = core_il2cpp_method("UnityEngine.CoreModule", "UnityEngine", "Transform", "Find", 1);
+    return Object_Instantiate && Component_get_transform && GameObject_get_transform && Transform_SetParent && Transform_Find;
+}
+
+// Starts loading the bundle in the background. The health warning is the first screen, so by the time the
+// main menu shows the load has usually finished.
+static void saber_cache_start() {
+    if (saber_cache.state != SABER_CACHE_EMPTY) {
+        return;
+    }
+    if (fileexists(bundle_path) != '\1') {
+        log("No saber bundle at path: %s", bundle_path);
+        saber_cache.state = SABER_CACHE_FAILED;
+        return;
+    }
+    log("Starting to load the saber bundle...");
+    void* (*LoadFromFileAsync)(cs_string*) = (void*)getRealOffset(AssetBundle_LoadFromFileAsync_offset);
+    saber_cache.bundle_request = LoadFromFileAsync(createcsstr(bundle_path, strlen(bundle_path)));
+    if (!saber_cache.bundle_request) {
+        saber_cache.state = SABER_CACHE_FAILED;
+        return;
+    }
+    core_il2cpp_keep_alive(saber_cache.bundle_request);
+    saber_cache.state = SABER_CACHE_LOADING;
+}
+
+// The prefab's child with that name, or the whole prefab if it has none. The hands share the prefab's
+// meshes and materials, only the instances are per saber.
+static void* find_hand_prefab(const char* name) {
+    void* (*get_gameObject)(void*) = (void*)getRealOffset(Component_get_gameObject_offset);
+    void* child = Transform_Find(GameObject_get_transform(saber_cache.prefab), createcsstr(name, strlen(name)));
+    if (!child) {
+        log("Saber prefab has no %s child, using all of it for that hand", name);
+        return saber_cache.prefab;
+    }
+    void* hand = get_gameObject(child);
+    core_il2cpp_keep_alive(hand);
+    return hand;
+}
+
+// Takes the bundle from its request and loads the prefab. get_assetBundle waits for the load if it has
+// not finished, so this runs on the main menu, never at level start.
+static void saber_cache_finish() {
+    if (saber_cache.state != SABER_CACHE_LOADING) {
+        return;
+    }
+    saber_cache.state = SABER_CACHE_FAILED;
+    void* (*get_assetBundle)(void*) = (void*)getRealOffset(AssetBundleCreateRequest_get_assetBundle_offset);
+    saber_cache.bundle = get_assetBundle(saber_cache.bundle_request);
+    if (!saber_cache.bundle) {
+        log("Could not load the saber bundle at path: %s", bundle_path);
+        return;
+    }
+    core_il2cpp_keep_alive(saber_cache.bundle);
+    void* game_object_type = core_il2cpp_type_object("UnityEngine.CoreModule", "UnityEngine", "GameObject");
+    if (!game_object_type || !resolve_methods()) {
+        return;
+    }
+    void* (*LoadAssetAsync)(void*, cs_string*, void*) = (void*)getRealOffset(AssetBundle_LoadAssetAsync_offset);
+    void* (*get_asset)(void*) = (void*)getRealOffset(AssetBundleRequest_get_asset_offset);
+    void* asset_request = LoadAssetAsync(saber_cache.bundle, createcsstr(SABER_ASSET_NAME, strlen(SABER_ASSET_NAME)), game_object_type);
+    saber_cache.prefab = asset_request ? get_asset(asset_request) : NULL;
+    if (!saber_cache.prefab) {
+        log("Saber bundle has no GameObject named %s!", SABER_ASSET_NAME);
+        return;
+    }
+    // The bundle stays loaded, so the prefab is valid for the whole session
+    core_il2cpp_keep_alive(saber_cache.prefab);
+    saber_cache.hand_prefabs[SABER_TYPE_A] = find_hand_prefab(LEFT_SABER_NAME);
+    saber_cache.hand_prefabs[SABER_TYPE_B] = find_hand_prefab(RIGHT_SABER_NAME);
+    saber_cache.state = SABER_CACHE_READY;
+    log("Cached the saber prefab!");
+}
+
+MAKE_HOOK(HealthWarningFlowCoordinator_DidActivate, HealthWarningFlowCoordinator_DidActivate_offset, void, void* self, char firstActivation, int activationType) {
+    HealthWarningFlowCoordinator_DidActivate(self, firstActivation, activationType);
+    saber_cache_start();
+}
+
+MAKE_HOOK(MainMenuViewController_DidActivate, MainMenuViewController_DidActivate_offset, void, void* self, char firstActivation, int activationType) {
+    MainMenuViewController_DidActivate(self, firstActivation, activationType);
+    // Also starts the load when the health warning was skipped
+    saber_cache_start();
+    saber_cache_finish();
+}
 
 MAKE_HOOK(Saber_start, 0x481080, void, void* self) {
-    log("Entering Saber.Start hook...");
     Saber_start(self);
-    log("Attempting to get AssetBundleCreateRequest...");
-    void* (*LoadFromFileAsync)(void*) = (void*)getRealOffset(0x1278B44);
-    void* assetBundleCreateRequest = LoadFromFileAsync(&PATH);
-    log("Attempting to get AssetBundle from AssetBundleCreateRequest...");
-    void* (*get_assetBundle)(void*) = (void*)getRealOffset(0x1278D60);
-    void* assetBundle = get_assetBundle(assetBundleCreateRequest);
-    log("Attempting to get GameObject from assetBundle...");
-    // Need to find the DAT object (int IL2CPP via ghidra) for the GameObject type
-    void* (*loadAssetAsync)(void*, void*, void*) = (void*)getRealOffset(0x5CD740);
-    void* gameobject = loadAssetAsync(assetBundle, "_customsaber", GO_TYPE);
+    if (saber_cache.state != SABER_CACHE_READY) {
+        // Never loads here, that would block the level start
+        return;
+    }
+    static int (*get_saberType)(void*) = NULL;
+    if (!get_saberType) {
+        get_saberType = (void*)getRealOffset(Saber_get_saberType_offset);
+    }
+    int type = get_saberType(self);
+    void* prefab = saber_cache.hand_prefabs[type == SABER_TYPE_B ? SABER_TYPE_B : SABER_TYPE_A];
+    // Instances use the prefab's shared meshes and materials, nothing is copied or uploaded again per level
+    void* saber = Object_Instantiate(prefab);
+    if (saber) {
+        Transform_SetParent(GameObject_get_transform(saber), Component_get_transform(self), '\0');
+        saber_cache.instances++;
+        log("Instantiated saber %i from the cached prefab, %i this session", type, saber_cache.instances);
+    }
+}
+
+// Hashes new and changed saber files. Nothing else uses the library once lib_main is done with it.
+static void* read_saber_library(void* arg) {
+    saber_library_read(&saber_library, SABER_LIBRARY_DIR, SABER_INDEX_FILE);
+    return NULL;
 }
 
 __attribute__((constructor)) void lib_main()
 {
+    // Only lists and stats the files, the selected bundle is loaded on the main menu
+    mkdir(SABER_LIBRARY_DIR, 0777);
+    saber_library_scan(&saber_library, SABER_LIBRARY_DIR, SABER_INDEX_FILE);
+    const saber_entry_t* selected = saber_library_selected(&saber_library, SABER_SELECTED_FILE);
+    if (selected) {
+        snprintf(bundle_path, sizeof(bundle_path), "%s/%s", SABER_LIBRARY_DIR, selected->name);
+        log("Selected saber %s (%llu bytes, Unity %s)", selected->name, (unsigned long long)selected->size, selected->unity_version[0] ? selected->unity_version : "not read yet");
+    }
+    // Reading grows with the size of the library, so it never blocks game startup
+    if (saber_library.unread_count > 0) {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, read_saber_library, NULL) == 0) {
+            pthread_detach(thread);
+        } else {
+            log("Could not start reading the saber library!");
+        }
+    }
     log("Installing Custom Sabers hooks...");
-
+    INSTALL_HOOK(HealthWarningFlowCoordinator_DidActivate);
+    INSTALL_HOOK(MainMenuViewController_DidActivate);
+    INSTALL_HOOK(Saber_start);
     log("Completed installing hooks!");
-}
\ No newline at end of file
+}
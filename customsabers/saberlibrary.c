@@ -0,0 +1,249 @@
+#include <android/log.h>
+#include <dirent.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "saberlibrary.h"
+
+#undef log
+#define log(...) __android_log_print(ANDROID_LOG_INFO, "QuestHook", "[CustomSabers] " __VA_ARGS__)
+
+#define HASH_BUFFER_SIZE 65536
+
+static int compare_entries(const void* a, const void* b) {
+    return strcmp(((const saber_entry_t*)a)->name, ((const saber_entry_t*)b)->name);
+}
+
+static char is_saber_file(const char* name) {
+    size_t len = strlen(name);
+    if (len >= SABER_NAME_SIZE) {
+        return '\0';
+    }
+    return (len > 6 && strcmp(name + len - 6, ".saber") == 0) || (len > 7 && strcmp(name + len - 7, ".bundle") == 0);
+}
+
+// Reads the old index, sorted by name. Returns the number of entries, 0 if there is no usable index.
+static int read_index(const char* path, saber_entry_t** entries) {
+    *entries = NULL;
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        return 0;
+    }
+    saber_index_header_t header;
+    int count = 0;
+    if (fread(&header, sizeof(header), 1, f) == 1 && header.magic == SABER_INDEX_MAGIC && header.version == SABER_INDEX_VERSION && header.entry_size == sizeof(saber_entry_t) && header.count > 0) {
+        *entries = malloc(header.count * sizeof(saber_entry_t));
+        if (*entries && fread(*entries, sizeof(saber_entry_t), header.count, f) == header.count) {
+            count = header.count;
+        }
+    }
+    fclose(f);
+    if (count == 0) {
+        free(*entries);
+        *entries = NULL;
+        return 0;
+    }
+    for (int i = 0; i < count; i++) {
+        (*entries)[i].name[SABER_NAME_SIZE - 1] = '\0';
+        (*entries)[i].unity_version[SABER_UNITY_VERSION_SIZE - 1] = '\0';
+    }
+    qsort(*entries, count, sizeof(saber_entry_t), compare_entries);
+    return count;
+}
+
+static int write_index(const char* path, const saber_entry_t* entries, int count) {
+    char temp[PATH_MAX];
+    snprintf(temp, sizeof(temp), "%s.tmp", path);
+    FILE* f = fopen(temp, "wb");
+    if (!f) {
+        return -1;
+    }
+    saber_index_header_t header = { SABER_INDEX_MAGIC, SABER_INDEX_VERSION, count, sizeof(saber_entry_t) };
+    char ok = fwrite(&header, sizeof(header), 1, f) == 1 && (count == 0 || fwrite(entries, sizeof(saber_entry_t), count, f) == (size_t)count);
+    if (fclose(f) != 0 || !ok || rename(temp, path) != 0) {
+        remove(temp);
+        return -1;
+    }
+    return 0;
+}
+
+// Big endian, as in the UnityFS header
+static uint32_t read_be32(const uint8_t* p) {
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+// UnityFS header: "UnityFS\0", format (u32 BE), player version string, engine version string, ...
+static void read_preview(const uint8_t* header, size_t len, saber_entry_t* entry) {
+    if (len < 12 || memcmp(header, "UnityFS", 8) != 0) {
+        return;
+    }
+    entry->bundle_format = read_be32(header + 8);
+    const uint8_t* player = header + 12;
+    const uint8_t* end = header + len;
+    const uint8_t* engine = memchr(player, '\0', end - player);
+    if (!engine || ++engine >= end) {
+        return;
+    }
+    const uint8_t* engine_end = memchr(engine, '\0', end - engine);
+    if (engine_end && engine_end - engine < SABER_UNITY_VERSION_SIZE) {
+        memcpy(entry->unity_version, engine, engine_end - engine);
+    }
+}
+
+// Hashes the file and reads its preview metadata, returns 0 on success
+static int read_entry(const char* path, saber_entry_t* entry) {
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        return -1;
+    }
+    uint8_t* buffer = malloc(HASH_BUFFER_SIZE);
+    if (!buffer) {
+        fclose(f);
+        return -1;
+    }
+    uint64_t hash = 14695981039346656037ull;
+    char first = '\1';
+    size_t n;
+    while ((n = fread(buffer, 1, HASH_BUFFER_SIZE, f)) > 0) {
+        if (first) {
+            read_preview(buffer, n, entry);
+            first = '\0';
+        }
+        for (size_t i = 0; i < n; i++) {
+            hash = (hash ^ buffer[i]) * 1099511628211ull;
+        }
+    }
+    entry->hash = hash;
+    free(buffer);
+    fclose(f);
+    return 0;
+}
+
+int saber_library_scan(saber_library_t* library, const char* dir, const char* index_path) {
+    memset(library, 0, sizeof(*library));
+    DIR* d = opendir(dir);
+    if (!d) {
+        log("Could not open the saber library at path: %s", dir);
+        return -1;
+    }
+    saber_entry_t* old = NULL;
+    int old_count = read_index(index_path, &old);
+    int capacity = old_count > 16 ? old_count : 16;
+    library->entries = malloc(capacity * sizeof(saber_entry_t));
+    if (!library->entries) {
+        closedir(d);
+        free(old);
+        return -1;
+    }
+    struct dirent* file;
+    char path[PATH_MAX];
+    while ((file = readdir(d)) != NULL) {
+        if (!is_saber_file(file->d_name)) {
+            continue;
+        }
+        snprintf(path, sizeof(path), "%s/%s", dir, file->d_name);
+        struct stat st;
+        if (stat(path, &st) != 0 || !S_ISREG(st.st_mode)) {
+            continue;
+        }
+        if (library->count == capacity) {
+            saber_entry_t* entries = realloc(library->entries, capacity * 2 * sizeof(saber_entry_t));
+            if (!entries) {
+                break;
+            }
+            library->entries = entries;
+            capacity *= 2;
+        }
+        saber_entry_t* entry = &library->entries[library->count++];
+        memset(entry, 0, sizeof(*entry));
+        strcpy(entry->name, file->d_name);
+        entry->size = st.st_size;
+        entry->mtime = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+    }
+    closedir(d);
+    qsort(library->entries, library->count, sizeof(saber_entry_t), compare_entries);
+    // Only the index lookups here, the files themselves are read by saber_library_read
+    library->unread = malloc((library->count > 0 ? library->count : 1) * sizeof(int));
+    for (int i = 0; i < library->count; i++) {
+        saber_entry_t* entry = &library->entries[i];
+        const saber_entry_t* known = old ? bsearch(entry, old, old_count, sizeof(saber_entry_t), compare_entries) : NULL;
+        if (known && known->size == entry->size && known->mtime == entry->mtime) {
+            *entry = *known;
+            library->reused++;
+        } else if (library->unread) {
+            library->unread[library->unread_count++] = i;
+        }
+    }
+    free(old);
+    // Removed files, nothing to read
+    if (library->unread_count == 0 && library->count != old_count) {
+        if (write_index(index_path, library->entries, library->count) != 0) {
+            log("Could not write the saber index at path: %s", index_path);
+        }
+    }
+    log("Saber library: %i sabers, %i from the index, %i to read", library->count, library->reused, library->unread_count);
+    return library->count;
+}
+
+int saber_library_read(saber_library_t* library, const char* dir, const char* index_path) {
+    if (library->unread_count == 0) {
+        return 0;
+    }
+    char path[PATH_MAX];
+    for (int i = 0; i < library->unread_count; i++) {
+        saber_entry_t* entry = &library->entries[library->unread[i]];
+        snprintf(path, sizeof(path), "%s/%s", dir, entry->name);
+        // A file that can not be read stays in the index without a hash, and is read again next launch
+        if (read_entry(path, entry) == 0) {
+            library->hashed++;
+        } else {
+            entry->mtime = 0;
+        }
+    }
+    library->unread_count = 0;
+    if (write_index(index_path, library->entries, library->count) != 0) {
+        log("Could not write the saber index at path: %s", index_path);
+    }
+    log("Saber library: read %i new or changed sabers", library->hashed);
+    return library->hashed;
+}
+
+const saber_entry_t* saber_library_find(const saber_library_t* library, const char* name) {
+    if (library->count == 0 || strlen(name) >= SABER_NAME_SIZE) {
+        return NULL;
+    }
+    saber_entry_t key;
+    memset(&key, 0, sizeof(key));
+    strcpy(key.name, name);
+    return bsearch(&key, library->entries, library->count, sizeof(saber_entry_t), compare_entries);
+}
+
+const saber_entry_t* saber_library_selected(const saber_library_t* library, const char* selected_path) {
+    if (library->count == 0) {
+        return NULL;
+    }
+    FILE* f = fopen(selected_path, "r");
+    if (f) {
+        char name[SABER_NAME_SIZE + 2];
+        char read = fgets(name, sizeof(name), f) != NULL;
+        fclose(f);
+        if (read) {
+            name[strcspn(name, "\r\n")] = '\0';
+            const saber_entry_t* entry = saber_library_find(library, name);
+            if (entry) {
+                return entry;
+            }
+            log("Selected saber %s is not in the library!", name);
+        }
+    }
+    return &library->entries[0];
+}
+
+void saber_library_free(saber_library_t* library) {
+    free(library->entries);
+    free(library->unread);
+    memset(library, 0, sizeof(*library));
+}
@@ -0,0 +1,73 @@
+#ifndef SABERLIBRARY_H
+#define SABERLIBRARY_H
+
+#include <stdint.h>
+
+// The saber library: every .saber or .bundle file in SABER_LIBRARY_DIR. A binary index of the files
+// (SABER_INDEX_FILE) keeps their hashes and preview metadata. The scan only lists and stats the files, taking
+// unchanged ones (same size and mtime) from the index, so it is cheap enough for load time. Files that are
+// new or changed are read later by saber_library_read, off the main thread, which then rewrites the index.
+// Bundles are not opened by either, only the selected one is loaded, when the main menu shows. Nothing here
+// calls into the game.
+
+#define SABER_LIBRARY_DIR "/sdcard/Android/data/com.beatgames.beatsaber/files/mods/CustomSabers"
+#define SABER_INDEX_FILE SABER_LIBRARY_DIR "/index.bin"
+// One line with the file name of the selected saber
+#define SABER_SELECTED_FILE SABER_LIBRARY_DIR "/selected.txt"
+
+#define SABER_INDEX_MAGIC 0x58495343 // "CSIX"
+#define SABER_INDEX_VERSION 1
+#define SABER_NAME_SIZE 64
+#define SABER_UNITY_VERSION_SIZE 24
+
+// Written to the index as is, so only fixed size fields and explicit padding
+typedef struct saber_entry {
+    // File name in SABER_LIBRARY_DIR
+    char name[SABER_NAME_SIZE];
+    uint64_t size;
+    // Modification time in ns
+    int64_t mtime;
+    // FNV-1a of the whole file
+    uint64_t hash;
+    // Preview metadata from the bundle header: the Unity version it was built with, empty if the file is
+    // not a UnityFS bundle
+    char unity_version[SABER_UNITY_VERSION_SIZE];
+    uint32_t bundle_format;
+    uint32_t reserved;
+} saber_entry_t;
+
+_Static_assert(sizeof(saber_entry_t) == 120, "saber_entry_t is part of the index format");
+
+typedef struct saber_index_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t count;
+    uint32_t entry_size;
+} saber_index_header_t;
+
+typedef struct saber_library {
+    // Sorted by name
+    saber_entry_t* entries;
+    int count;
+    // Indexes of the entries that are new or changed, their hash and preview are not read yet
+    int* unread;
+    int unread_count;
+    // Files read by saber_library_read, and files taken from the index as they were
+    int hashed;
+    int reused;
+} saber_library_t;
+
+// Lists and stats dir, reusing the entries in index_path for unchanged files. Rewrites the index if files
+// were only removed, otherwise saber_library_read does. Returns the number of sabers, or -1 if the
+// directory can not be read.
+int saber_library_scan(saber_library_t* library, const char* dir, const char* index_path);
+// Hashes the unread files and reads their preview metadata, then rewrites the index. Reads whole files, so
+// call it off the main thread. The entries are not to be used while it runs. Returns the number read.
+int saber_library_read(saber_library_t* library, const char* dir, const char* index_path);
+// The entry with that file name, or NULL
+const saber_entry_t* saber_library_find(const saber_library_t* library, const char* name);
+// The entry named in selected_path, or the first one if there is none. NULL if the library is empty.
+const saber_entry_t* saber_library_selected(const saber_library_t* library, const char* selected_path);
+void saber_library_free(saber_library_t* library);
+
+#endif /* SABERLIBRARY_H */
@@ -0,0 +1,41 @@
+# Copyright (C) 2009 The Android Open Source Project
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+#
+#
+LOCAL_PATH := $(call my-dir)
+
+TARGET_ARCH_ABI := armeabi-v7a
+
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := hook
+#LOCAL_SRC_FILES := $(LOCAL_PATH)/../obj/local/armeabi-v7a/libhook.a
+#LOCAL_EXPORT_C_INCLUDES := $(LOCAL_PATH)/../include
+
+# Built by ../core
+include $(CLEAR_VARS)
+LOCAL_MODULE := questhookcore
+LOCAL_SRC_FILES := ../core/libs/$(TARGET_ARCH_ABI)/lib0questhookcore.so
+include $(PREBUILT_SHARED_LIBRARY)
+
+include $(CLEAR_VARS)
+LOCAL_LDLIBS := -llog
+LOCAL_MODULE    := gameplayevents
+# Loaded after lib0questhookcore.so and before the mods that subscribe, see ../core/Android.mk
+LOCAL_MODULE_FILENAME := lib1gameplayevents
+LOCAL_SRC_FILES := main.c
+LOCAL_SHARED_LIBRARIES := questhookcore
+#LOCAL_STATIC_LIBRARIES := libhook
+include $(BUILD_SHARED_LIBRARY)
@@ -0,0 +1,2 @@
+APP_ABI := armeabi-v7a
+APP_PIE:= true
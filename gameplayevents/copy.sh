@@ -0,0 +1,13 @@
+#!/bin/bash
+set -e
+(cd ../core && ndk-build NDK_PROJECT_PATH=. APP_BUILD_SCRIPT=./Android.mk NDK_APPLICATION_MK=./Application.mk)
+adb push ../core/libs/armeabi-v7a/lib0questhookcore.so /sdcard/Android/data/com.beatgames.beatsaber/files/mods/lib0questhookcore.so
+# Left over from before the core was renamed to load first
+adb shell rm -f /sdcard/Android/data/com.beatgames.beatsaber/files/mods/libquesthookcore.so /sdcard/Android/data/com.beatgames.beatsaber/files/mods/libgameplayevents.so
+ndk-build NDK_PROJECT_PATH=. APP_BUILD_SCRIPT=./Android.mk NDK_APPLICATION_MK=./Application.mk
+adb push libs/armeabi-v7a/lib1gameplayevents.so /sdcard/Android/data/com.beatgames.beatsaber/files/mods/lib1gameplayevents.so
+adb shell am force-stop com.beatgames.beatsaber
+#adb shell input keyevent KEYCODE_DPAD_RIGHT
+#adb shell input keyevent KEYCODE_SPACE
+
+adb shell am start com.beatgames.beatsaber/com.unity3d.player.UnityPlayerActivity
@@ -0,0 +1,84 @@
+#ifndef GAMEPLAYEVENTS_H
+#define GAMEPLAYEVENTS_H
+
+#include <stdint.h>
+
+// Gameplay event bus, built as lib1gameplayevents.so.
+// The library owns the only hook on each game method below and decodes its arguments once.
+// Mods link against it and subscribe instead of hooking the same methods themselves.
+// Each event type keeps its subscribers in one flat array, sorted by priority (highest first,
+// equal priorities in the order they subscribed). Dispatch walks the array and checks the filter masks.
+// Subscribing is meant for load time (a mod's lib_main). It is safe while events are dispatched, but
+// the old array is never freed.
+
+struct ScoreController;
+struct NoteController;
+struct NoteCutInfo;
+struct FlyingScoreEffect;
+struct score_snapshot;
+
+typedef enum gameplay_event_type {
+    // ScoreController.HandleNoteWasCutEvent, after the game scored the cut
+    GAMEPLAY_EVENT_NOTE_CUT = 0,
+    // ScoreController.HandleNoteWasMissedEvent
+    GAMEPLAY_EVENT_NOTE_MISSED = 1,
+    // FlyingScoreEffect.HandleSaberAfterCutSwingRatingCounterDidChangeEvent, with the raw score parts
+    // from ScoreController.RawScoreWithoutMultiplier. Carries the saber but no note type.
+    GAMEPLAY_EVENT_SWING_RATING_CHANGED = 2,
+    // ScoreController.LateUpdate, with a snapshot of the score state (see temp/scorestate.h).
+    // Once per frame while a song is loaded, so it doubles as the gameplay frame tick.
+    GAMEPLAY_EVENT_SCORE_FRAME = 3,
+    // AudioTimeSyncController.StartSong, before the song starts playing
+    GAMEPLAY_EVENT_SONG_START = 4,
+    // StandardLevelGameplayManager.OnDestroy, before it runs. Fires however the song ended:
+    // finished, failed, quit or restarted.
+    GAMEPLAY_EVENT_SONG_END = 5,
+    GAMEPLAY_EVENT_COUNT = 6
+} gameplay_event_type_t;
+
+// Filter bits, one per NoteType / SaberType value, plus one for events that have none
+#define GAMEPLAY_NOTE_A (1u << 0)
+#define GAMEPLAY_NOTE_B (1u << 1)
+#define GAMEPLAY_NOTE_GHOST (1u << 2)
+#define GAMEPLAY_NOTE_BOMB (1u << 3)
+#define GAMEPLAY_NOTE_NONE (1u << 4)
+#define GAMEPLAY_NOTE_ANY 0x1Fu
+#define GAMEPLAY_SABER_A (1u << 0)
+#define GAMEPLAY_SABER_B (1u << 1)
+#define GAMEPLAY_SABER_NONE (1u << 2)
+#define GAMEPLAY_SABER_ANY 0x7u
+
+// Values of note_type / saber_type for events that have none
+#define GAMEPLAY_NOTE_TYPE_NONE 4
+#define GAMEPLAY_SABER_TYPE_NONE 2
+
+typedef struct gameplay_event {
+    gameplay_event_type_t type;
+    // enum NoteType / enum SaberType, or GAMEPLAY_*_TYPE_NONE
+    int note_type;
+    int saber_type;
+    // Whichever of these the event has, NULL otherwise
+    struct ScoreController* score_controller;
+    struct NoteController* note_controller;
+    struct NoteCutInfo* note_cut_info;
+    struct FlyingScoreEffect* flying_score_effect;
+    // GAMEPLAY_EVENT_SWING_RATING_CHANGED
+    float rating;
+    int before_cut;
+    int after_cut;
+    int cut_distance;
+    // GAMEPLAY_EVENT_SCORE_FRAME
+    const struct score_snapshot* score;
+} gameplay_event_t;
+
+typedef void (*gameplay_event_callback_t)(const gameplay_event_t* event, void* context);
+
+// Most subscribers a single event type can have
+#define GAMEPLAY_MAX_SUBSCRIBERS 64
+
+// Calls callback for every event of the given type whose note and saber match the GAMEPLAY_NOTE_* and
+// GAMEPLAY_SABER_* masks. Returns an id for gameplay_events_unsubscribe, or -1 if the type is full.
+int gameplay_events_subscribe(gameplay_event_type_t type, int priority, uint32_t note_types, uint32_t sabers, gameplay_event_callback_t callback, void* context);
+void gameplay_events_unsubscribe(int id);
+
+#endif /* GAMEPLAYEVENTS_H */
@@ -0,0 +1,262 @@
+#include <android/log.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "../core/core.h"
+#include "../temp/scorestate.h"
+#include "gameplayevents.h"
+
+#undef log
+#define log(...) __android_log_print(ANDROID_LOG_INFO, "QuestHook", "[GameplayEvents v0.1.0] " __VA_ARGS__)
+
+// ScoreController.HandleNoteWasCutEvent: 0x48CE5C
+#define ScoreController_HandleNoteWasCutEvent_offset 0x48CE5C
+// ScoreController.HandleNoteWasMissedEvent: 0x48D240
+#define ScoreController_HandleNoteWasMissedEvent_offset 0x48D240
+// ScoreController.LateUpdate: 0x48CB04
+#define ScoreController_LateUpdate_offset 0x48CB04
+// ScoreController.RawScoreWithoutMultiplier: 0x48C248
+#define RawScoreWithoutMultiplier_offset 0x48C248
+// FlyingScoreEffect.HandleSaberAfterCutSwingRatingCounterDidChangeEvent: 0x13233DC
+#define HandleSaberAfterCutSwingRatingCounterDidChangeEvent_offset 0x13233DC
+// AudioTimeSyncController.StartSong: 0x12A2E88
+#define AudioTimeSyncController_StartSong_offset 0x12A2E88
+// StandardLevelGameplayManager.OnDestroy: 0x12EDDA4
+#define StandardLevelGameplayManager_OnDestroy_offset 0x12EDDA4
+
+typedef struct gameplay_subscriber {
+    gameplay_event_callback_t callback;
+    void* context;
+    uint32_t note_types;
+    uint32_t sabers;
+    int priority;
+    int id;
+} gameplay_subscriber_t;
+
+// Never changed once published, subscribing publishes a new copy
+typedef struct gameplay_subscriber_list {
+    int count;
+    gameplay_subscriber_t subscribers[];
+} gameplay_subscriber_list_t;
+
+static gameplay_subscriber_list_t* subscriber_lists[GAMEPLAY_EVENT_COUNT];
+static pthread_mutex_t subscribe_lock = PTHREAD_MUTEX_INITIALIZER;
+static int next_id = 0;
+
+static gameplay_subscriber_list_t* copy_list(const gameplay_subscriber_list_t* list, int extra) {
+    int count = list ? list->count : 0;
+    gameplay_subscriber_list_t* copy = malloc(sizeof(gameplay_subscriber_list_t) + (count + extra) * sizeof(gameplay_subscriber_t));
+    if (!copy) {
+        return NULL;
+    }
+    copy->count = count;
+    if (count > 0) {
+        memcpy(copy->subscribers, list->subscribers, count * sizeof(gameplay_subscriber_t));
+    }
+    return copy;
+}
+
+int gameplay_events_subscribe(gameplay_event_type_t type, int priority, uint32_t note_types, uint32_t sabers, gameplay_event_callback_t callback, void* context) {
+    if (type < 0 || type >= GAMEPLAY_EVENT_COUNT || !callback) {
+        return -1;
+    }
+    pthread_mutex_lock(&subscribe_lock);
+    gameplay_subscriber_list_t* list = subscriber_lists[type];
+    if (list && list->count >= GAMEPLAY_MAX_SUBSCRIBERS) {
+        pthread_mutex_unlock(&subscribe_lock);
+        log("Too many subscribers for event type %i!", type);
+        return -1;
+    }
+    gameplay_subscriber_list_t* copy = copy_list(list, 1);
+    if (!copy) {
+        pthread_mutex_unlock(&subscribe_lock);
+        return -1;
+    }
+    // Insert after every subscriber with the same or a higher priority
+    int index = copy->count;
+    while (index > 0 && copy->subscribers[index - 1].priority < priority) {
+        copy->subscribers[index] = copy->subscribers[index - 1];
+        index--;
+    }
+    gameplay_subscriber_t* subscriber = &copy->subscribers[index];
+    subscriber->callback = callback;
+    subscriber->context = context;
+    subscriber->note_types = note_types;
+    subscriber->sabers = sabers;
+    subscriber->priority = priority;
+    subscriber->id = next_id++;
+    copy->count++;
+    int id = subscriber->id;
+    // The old list is not freed, a dispatch on another thread may still be walking it
+    __atomic_store_n(&subscriber_lists[type], copy, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&subscribe_lock);
+    return id;
+}
+
+void gameplay_events_unsubscribe(int id) {
+    pthread_mutex_lock(&subscribe_lock);
+    for (int type = 0; type < GAMEPLAY_EVENT_COUNT; type++) {
+        gameplay_subscriber_list_t* list = subscriber_lists[type];
+        if (!list) {
+            continue;
+        }
+        for (int i = 0; i < list->count; i++) {
+            if (list->subscribers[i].id != id) {
+                continue;
+            }
+            gameplay_subscriber_list_t* copy = copy_list(list, 0);
+            if (copy) {
+                memmove(&copy->subscribers[i], &copy->subscribers[i + 1], (copy->count - i - 1) * sizeof(gameplay_subscriber_t));
+                copy->count--;
+                __atomic_store_n(&subscriber_lists[type], copy, __ATOMIC_RELEASE);
+            }
+            pthread_mutex_unlock(&subscribe_lock);
+            return;
+        }
+    }
+    pthread_mutex_unlock(&subscribe_lock);
+}
+
+static inline gameplay_subscriber_list_t* get_subscribers(gameplay_event_type_t type) {
+    gameplay_subscriber_list_t* list = __atomic_load_n(&subscriber_lists[type], __ATOMIC_ACQUIRE);
+    return list && list->count > 0 ? list : NULL;
+}
+
+static void dispatch(const gameplay_subscriber_list_t* list, const gameplay_event_t* event) {
+    uint32_t note = 1u << event->note_type;
+    uint32_t saber = 1u << event->saber_type;
+    for (int i = 0; i < list->count; i++) {
+        const gameplay_subscriber_t* subscriber = &list->subscribers[i];
+        if ((subscriber->note_types & note) && (subscriber->sabers & saber)) {
+            subscriber->callback(event, subscriber->context);
+        }
+    }
+}
+
+static int note_type_of(struct NoteController* noteController) {
+    if (!noteController || !noteController->_noteData) {
+        return GAMEPLAY_NOTE_TYPE_NONE;
+    }
+    int type = noteController->_noteData->_type;
+    return type >= NoteType_NoteA && type <= NoteType_Bomb ? type : GAMEPLAY_NOTE_TYPE_NONE;
+}
+
+static int saber_type_of(struct NoteCutInfo* noteCutInfo) {
+    if (!noteCutInfo) {
+        return GAMEPLAY_SABER_TYPE_NONE;
+    }
+    int type = noteCutInfo->saberType_k__BackingField;
+    return type == SaberType_SaberA || type == SaberType_SaberB ? type : GAMEPLAY_SABER_TYPE_NONE;
+}
+
+static void init_event(gameplay_event_t* event, gameplay_event_type_t type) {
+    memset(event, 0, sizeof(*event));
+    event->type = type;
+    event->note_type = GAMEPLAY_NOTE_TYPE_NONE;
+    event->saber_type = GAMEPLAY_SABER_TYPE_NONE;
+}
+
+MAKE_HOOK(ScoreController_HandleNoteWasCutEvent, ScoreController_HandleNoteWasCutEvent_offset, void, struct ScoreController* self, struct BeatmapObjectSpawnController* noteSpawnController, struct NoteController* noteController, struct NoteCutInfo* noteCutInfo) {
+    ScoreController_HandleNoteWasCutEvent(self, noteSpawnController, noteController, noteCutInfo);
+    gameplay_subscriber_list_t* list = get_subscribers(GAMEPLAY_EVENT_NOTE_CUT);
+    if (!list) {
+        return;
+    }
+    gameplay_event_t event;
+    init_event(&event, GAMEPLAY_EVENT_NOTE_CUT);
+    event.note_type = note_type_of(noteController);
+    event.saber_type = saber_type_of(noteCutInfo);
+    event.score_controller = self;
+    event.note_controller = noteController;
+    event.note_cut_info = noteCutInfo;
+    dispatch(list, &event);
+}
+
+MAKE_HOOK(ScoreController_HandleNoteWasMissedEvent, ScoreController_HandleNoteWasMissedEvent_offset, void, struct ScoreController* self, struct BeatmapObjectSpawnController* noteSpawnController, struct NoteController* noteController) {
+    ScoreController_HandleNoteWasMissedEvent(self, noteSpawnController, noteController);
+    gameplay_subscriber_list_t* list = get_subscribers(GAMEPLAY_EVENT_NOTE_MISSED);
+    if (!list) {
+        return;
+    }
+    gameplay_event_t event;
+    init_event(&event, GAMEPLAY_EVENT_NOTE_MISSED);
+    event.note_type = note_type_of(noteController);
+    event.score_controller = self;
+    event.note_controller = noteController;
+    dispatch(list, &event);
+}
+
+MAKE_HOOK(ScoreController_LateUpdate, ScoreController_LateUpdate_offset, void, struct ScoreController* self) {
+    ScoreController_LateUpdate(self);
+    gameplay_subscriber_list_t* list = get_subscribers(GAMEPLAY_EVENT_SCORE_FRAME);
+    if (!list) {
+        return;
+    }
+    score_snapshot_t snapshot;
+    score_controller_snapshot(self, &snapshot);
+    gameplay_event_t event;
+    init_event(&event, GAMEPLAY_EVENT_SCORE_FRAME);
+    event.score_controller = self;
+    event.score = &snapshot;
+    dispatch(list, &event);
+}
+
+MAKE_HOOK(HandleSaberAfterCutSwingRatingCounterDidChangeEvent, HandleSaberAfterCutSwingRatingCounterDidChangeEvent_offset, void, struct FlyingScoreEffect* self, struct SaberAfterCutSwingRatingCounter* saberAfterCutSwingRatingCounter, float rating) {
+    HandleSaberAfterCutSwingRatingCounterDidChangeEvent(self, saberAfterCutSwingRatingCounter, rating);
+    gameplay_subscriber_list_t* list = get_subscribers(GAMEPLAY_EVENT_SWING_RATING_CHANGED);
+    if (!list) {
+        return;
+    }
+    static void (*raw_score_without_multiplier)(struct NoteCutInfo*, struct SaberAfterCutSwingRatingCounter*, int*, int*, int*) = NULL;
+    if (!raw_score_without_multiplier) {
+        raw_score_without_multiplier = (void*)getRealOffset(RawScoreWithoutMultiplier_offset);
+    }
+    gameplay_event_t event;
+    init_event(&event, GAMEPLAY_EVENT_SWING_RATING_CHANGED);
+    event.saber_type = saber_type_of(self->_noteCutInfo);
+    event.note_cut_info = self->_noteCutInfo;
+    event.flying_score_effect = self;
+    event.rating = rating;
+    // Decoded once here for every subscriber
+    raw_score_without_multiplier(self->_noteCutInfo, self->_saberAfterCutSwingRatingCounter, &event.before_cut, &event.after_cut, &event.cut_distance);
+    dispatch(list, &event);
+}
+
+// Dispatches an event that carries nothing but its type
+static void dispatch_empty(gameplay_event_type_t type) {
+    gameplay_subscriber_list_t* list = get_subscribers(type);
+    if (!list) {
+        return;
+    }
+    gameplay_event_t event;
+    init_event(&event, type);
+    dispatch(list, &event);
+}
+
+MAKE_HOOK(AudioTimeSyncController_StartSong, AudioTimeSyncController_StartSong_offset, void, void* self) {
+    dispatch_empty(GAMEPLAY_EVENT_SONG_START);
+    AudioTimeSyncController_StartSong(self);
+}
+
+MAKE_HOOK(StandardLevelGameplayManager_OnDestroy, StandardLevelGameplayManager_OnDestroy_offset, void, void* self) {
+    dispatch_empty(GAMEPLAY_EVENT_SONG_END);
+    StandardLevelGameplayManager_OnDestroy(self);
+}
+
+__attribute__((constructor)) void lib_main()
+{
+    log("Inserting GameplayEvents...");
+    INSTALL_HOOK(ScoreController_HandleNoteWasCutEvent);
+    log("Installed ScoreController_HandleNoteWasCutEvent Hook!");
+    INSTALL_HOOK(ScoreController_HandleNoteWasMissedEvent);
+    log("Installed ScoreController_HandleNoteWasMissedEvent Hook!");
+    INSTALL_HOOK(ScoreController_LateUpdate);
+    log("Installed ScoreController_LateUpdate Hook!");
+    INSTALL_HOOK(HandleSaberAfterCutSwingRatingCounterDidChangeEvent);
+    log("Installed HandleSaberAfterCutSwingRatingCounterDidChangeEvent Hook!");
+    INSTALL_HOOK(AudioTimeSyncController_StartSong);
+    log("Installed AudioTimeSyncController_StartSong Hook!");
+    INSTALL_HOOK(StandardLevelGameplayManager_OnDestroy);
+    log("Installed StandardLevelGameplayManager_OnDestroy Hook!");
+}
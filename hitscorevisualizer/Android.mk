@@ -24,9 +24,22 @@ LOCAL_MODULE := hook
 #LOCAL_SRC_FILES := $(LOCAL_PATH)/../obj/local/armeabi-v7a/libhook.a
 #LOCAL_EXPORT_C_INCLUDES := $(LOCAL_PATH)/../include
 
+# Built by ../core
+include $(CLEAR_VARS)
+LOCAL_MODULE := questhookcore
+LOCAL_SRC_FILES := ../core/libs/$(TARGET_ARCH_ABI)/lib0questhookcore.so
+include $(PREBUILT_SHARED_LIBRARY)
+
+# Built by ../gameplayevents
+include $(CLEAR_VARS)
+LOCAL_MODULE := gameplayevents
+LOCAL_SRC_FILES := ../gameplayevents/libs/$(TARGET_ARCH_ABI)/lib1gameplayevents.so
+include $(PREBUILT_SHARED_LIBRARY)
+
 include $(CLEAR_VARS)
 LOCAL_LDLIBS := -llog
 LOCAL_MODULE    := hitscorevisualizer
-LOCAL_SRC_FILES := main.c ../beatsaber-hook/shared/utils/utils.c ../beatsaber-hook/shared/inline-hook/inlineHook.c ../beatsaber-hook/shared/inline-hook/relocate.c
+LOCAL_SRC_FILES := main.c alloccount.c
+LOCAL_SHARED_LIBRARIES := gameplayevents questhookcore
 #LOCAL_STATIC_LIBRARIES := libhook
 include $(BUILD_SHARED_LIBRARY)
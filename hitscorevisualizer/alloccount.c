@@ -0,0 +1,180 @@
+#include <android/log.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "alloccount.h"
+
+#undef log
+#define log(...) __android_log_print(ANDROID_LOG_INFO, "QuestHook", "[HitScoreVisualizer v1.4.8.5] " __VA_ARGS__)
+
+int alloc_budget_per_hit = 0;
+
+static alloc_site_t* sites = NULL;
+
+// Current song
+static char song_running = '\0';
+static int song_number = 0;
+static uint64_t song_hits = 0;
+static uint64_t song_frames = 0;
+static uint64_t song_allocations = 0;
+static uint64_t song_bytes = 0;
+static uint64_t song_frames_allocating = 0;
+static uint64_t max_frame_allocations = 0;
+static uint64_t max_frame_bytes = 0;
+// Current frame
+static uint64_t frame_allocations = 0;
+static uint64_t frame_bytes = 0;
+
+// Size of a System.String on the managed heap: object header, length and the
+// null terminated UTF-16 characters
+static uint64_t alloc_string_size(cs_string* str) {
+    return sizeof(cs_string) + (uint64_t)(str->len + 1) * sizeof(uint16_t);
+}
+
+static void alloc_count(alloc_site_t* site, cs_string* str) {
+    if (!str) {
+        return;
+    }
+    if (site->registered == '\0') {
+        site->registered = '\1';
+        site->next = sites;
+        sites = site;
+    }
+    uint64_t bytes = alloc_string_size(str);
+    site->allocations++;
+    site->bytes += bytes;
+    frame_allocations++;
+    frame_bytes += bytes;
+    song_allocations++;
+    song_bytes += bytes;
+}
+
+cs_string* alloc_createcsstr(alloc_site_t* site, const char* str, int len) {
+    cs_string* result = createcsstr((char*)str, len);
+    alloc_count(site, result);
+    return result;
+}
+
+cs_string* alloc_concat(alloc_site_t* site, cs_string* a, cs_string* b) {
+    // System.String.Concat: 0x972F2C
+    static cs_string* (*concat)(cs_string*, cs_string*) = NULL;
+    if (!concat) {
+        concat = (void*)getRealOffset(CONCAT_STRING_OFFSET);
+    }
+    cs_string* result = concat(a, b);
+    // Concat with an empty string hands back the other one
+    if (result != a && result != b) {
+        alloc_count(site, result);
+    }
+    return result;
+}
+
+cs_string* alloc_replace(alloc_site_t* site, cs_string* str, cs_string* old_value, cs_string* new_value) {
+    // System.String.Replace: 0x97FF04
+    static cs_string* (*replace)(cs_string*, cs_string*, cs_string*) = NULL;
+    if (!replace) {
+        replace = (void*)getRealOffset(STRING_REPLACE_OFFSET);
+    }
+    cs_string* result = replace(str, old_value, new_value);
+    // Replace hands back the same string when there is nothing to replace
+    if (result != str) {
+        alloc_count(site, result);
+    }
+    return result;
+}
+
+// Folds the current frame into the song totals
+static void alloc_end_frame() {
+    if (frame_allocations > 0) {
+        song_frames_allocating++;
+    }
+    if (frame_allocations > max_frame_allocations) {
+        max_frame_allocations = frame_allocations;
+    }
+    if (frame_bytes > max_frame_bytes) {
+        max_frame_bytes = frame_bytes;
+    }
+    frame_allocations = 0;
+    frame_bytes = 0;
+}
+
+static void alloc_reset() {
+    for (alloc_site_t* site = sites; site; site = site->next) {
+        site->allocations = 0;
+        site->bytes = 0;
+    }
+    song_hits = 0;
+    song_frames = 0;
+    song_allocations = 0;
+    song_bytes = 0;
+    song_frames_allocating = 0;
+    max_frame_allocations = 0;
+    max_frame_bytes = 0;
+    frame_allocations = 0;
+    frame_bytes = 0;
+}
+
+void alloc_song_start() {
+    if (song_running == '\1') {
+        alloc_song_end();
+    }
+    alloc_reset();
+    song_running = '\1';
+    song_number++;
+}
+
+void alloc_frame() {
+    if (song_running == '\0') {
+        return;
+    }
+    alloc_end_frame();
+    song_frames++;
+}
+
+void alloc_hit() {
+    song_hits++;
+}
+
+void alloc_song_end() {
+    if (song_running == '\0') {
+        return;
+    }
+    song_running = '\0';
+    alloc_end_frame();
+    double hits = song_hits > 0 ? (double)song_hits : 1.0;
+    double frames = song_frames > 0 ? (double)song_frames : 1.0;
+    double per_hit = song_allocations / hits;
+    log("Song %i: %llu allocations, %llu bytes over %llu hits (%.1f allocations per hit)", song_number, (unsigned long long)song_allocations, (unsigned long long)song_bytes, (unsigned long long)song_hits, per_hit);
+
+    FILE* fp = fopen(ALLOC_REPORT_FILE, "a");
+    if (!fp) {
+        log("Could not open allocation report at path: %s", ALLOC_REPORT_FILE);
+        return;
+    }
+    char date[32];
+    time_t now = time(NULL);
+    strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", localtime(&now));
+    fprintf(fp, "Song %i (%s)\n", song_number, date);
+    fprintf(fp, "Hits: %llu, frames: %llu\n", (unsigned long long)song_hits, (unsigned long long)song_frames);
+    fprintf(fp, "Allocations: %llu (%.1f per hit, %.2f per frame)\n", (unsigned long long)song_allocations, per_hit, song_allocations / frames);
+    fprintf(fp, "Bytes: %llu (%.1f per hit, %.1f per frame)\n", (unsigned long long)song_bytes, song_bytes / hits, song_bytes / frames);
+    fprintf(fp, "Frames allocating: %llu, max per frame: %llu allocations, %llu bytes\n", (unsigned long long)song_frames_allocating, (unsigned long long)max_frame_allocations, (unsigned long long)max_frame_bytes);
+    if (alloc_budget_per_hit > 0) {
+        if (per_hit > alloc_budget_per_hit) {
+            fprintf(fp, "Budget: %i allocations per hit, OVER by %.1f\n", alloc_budget_per_hit, per_hit - alloc_budget_per_hit);
+            log("Over allocation budget: %.1f allocations per hit, budget is %i", per_hit, alloc_budget_per_hit);
+        } else {
+            fprintf(fp, "Budget: %i allocations per hit, ok\n", alloc_budget_per_hit);
+        }
+    }
+    fprintf(fp, "%-40s %12s %12s %10s %10s\n", "Site", "Allocations", "Bytes", "Per hit", "Bytes/hit");
+    for (alloc_site_t* site = sites; site; site = site->next) {
+        if (site->allocations == 0) {
+            continue;
+        }
+        fprintf(fp, "%-40s %12llu %12llu %10.2f %10.1f\n", site->name, (unsigned long long)site->allocations, (unsigned long long)site->bytes, site->allocations / hits, site->bytes / hits);
+    }
+    fprintf(fp, "\n");
+    fclose(fp);
+}
@@ -0,0 +1,42 @@
+#ifndef ALLOCCOUNT_H
+#define ALLOCCOUNT_H
+
+#include <stdint.h>
+#include "../core/core.h"
+
+// Counts the managed strings the mod creates, so the GC pressure of a change can be measured.
+// Every createcsstr, String.Concat and String.Replace call goes through a wrapper that takes the
+// site it is called from. Counts are kept per site, per frame and per song, and a report is
+// appended to ALLOC_REPORT_FILE at the end of every song.
+// Everything here runs on the main thread, so there is no locking.
+
+#define ALLOC_REPORT_FILE "/sdcard/Android/data/com.beatgames.beatsaber/files/mods/HitScoreVisualizerAllocations.txt"
+
+typedef struct alloc_site {
+    const char* name;
+    uint64_t allocations;
+    uint64_t bytes;
+    // Set once the site is in the report list
+    char registered;
+    struct alloc_site* next;
+} alloc_site_t;
+
+#define ALLOC_SITE(name) { name, 0, 0, '\0', NULL }
+
+// Allocations per hit that the song report checks against, 0 to not check
+extern int alloc_budget_per_hit;
+
+cs_string* alloc_createcsstr(alloc_site_t* site, const char* str, int len);
+cs_string* alloc_concat(alloc_site_t* site, cs_string* a, cs_string* b);
+cs_string* alloc_replace(alloc_site_t* site, cs_string* str, cs_string* old_value, cs_string* new_value);
+
+// Resets the counters for a new song. A song that was still running is reported first.
+void alloc_song_start();
+// Called once per frame while a song is running
+void alloc_frame();
+// Called once per cut note (a note cut event, not every swing rating update)
+void alloc_hit();
+// Writes the report for the current song
+void alloc_song_end();
+
+#endif /* ALLOCCOUNT_H */
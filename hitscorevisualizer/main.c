@@ -11,11 +11,12 @@
 #include <sys/sendfile.h>
 #include <sys/stat.h>
 
-#include "../beatsaber-hook/shared/inline-hook/inlineHook.h"
-#include "../beatsaber-hook/shared/utils/utils.h"
+#include "../core/core.h"
 #ifndef JSMN_INCLUDED
 #include "../beatsaber-hook/jsmn/jsmn.h"
 #endif
+#include "alloccount.h"
+#include "../gameplayevents/gameplayevents.h"
 
 #undef log
 #define log(...) __android_log_print(ANDROID_LOG_INFO, "QuestHook", "[HitScoreVisualizer v1.4.8.5] " __VA_ARGS__)
@@ -33,10 +34,6 @@
 #define TMP_Text_get_text_offset 0x510D88
 // TMP_Text.set_text: 0x510D90
 #define TMP_Text_set_text_offset 0x510D90
-// ScoreController.RawScoreWithoutMultiplier: 0x48C248
-#define RawScoreWithoutMulitplier_offset 0x48C248
-// HandleSaberAfterCutSwingRatingCounterDidChangeEvent: 0x13233DC
-#define HandleSaberAfterCutSwingRatingCounterDidChangeEvent_offset 0x13233DC
 
 typedef struct {
     // First field begins at 0x58, could fill in useless
@@ -86,6 +83,14 @@ int afterCut_count = 0;
 
 DisplayMode_t display_mode;
 
+// Allocation sites in checkJudgements, see alloccount.h
+alloc_site_t judgement_site = ALLOC_SITE("checkJudgements judgement text");
+alloc_site_t format_key_site = ALLOC_SITE("checkJudgements format key");
+alloc_site_t format_value_site = ALLOC_SITE("checkJudgements format value");
+alloc_site_t format_replace_site = ALLOC_SITE("checkJudgements format replace");
+alloc_site_t newline_site = ALLOC_SITE("checkJudgements newline");
+alloc_site_t concat_site = ALLOC_SITE("checkJudgements concat");
+
 void createdefaultjson(const char* filename) {
     const char* js = "\n{\n"
     "\t\"majorVersion\": 2,\n"
@@ -386,6 +391,12 @@ int loadjudgements(const char* js) {
                 i++;
                 continue;
             }
+            else if (strcmp(buffer, "allocationBudget") == 0) {
+                // Allocations per hit checked in the song report, 0 to not check
+                alloc_budget_per_hit = intfromjson(js, tokens[i + 1]);
+                i++;
+                continue;
+            }
             else if (strcmp(buffer, "judgements") == 0) {
                 if (version_match == '\0') {
                     // Version doesn't match. Return default.
@@ -490,12 +501,8 @@ void checkJudgements(FlyingScoreEffect* scorePointer, int beforeCut, int afterCu
 
     log("Attempting to create judgement_cs string...");
     cs_string* newText = NULL;
-    // System.String.Concat: 0x972F2C
-    cs_string* (*concat)(cs_string*, cs_string*) = (void*)getRealOffset(CONCAT_STRING_OFFSET);
-    // System.String.Replace: 0x97FF04
-    cs_string* (*replace)(cs_string*, cs_string*, cs_string*) = (void*)getRealOffset(STRING_REPLACE_OFFSET);
     // Create default judgement_cs:
-    cs_string* judgement_cs = createcsstr(best.text, strlen(best.text));
+    cs_string* judgement_cs = alloc_createcsstr(&judgement_site, best.text, strlen(best.text));
     switch (display_mode)
     {
     case DISPLAY_MODE_FORMAT:
@@ -504,36 +511,36 @@ void checkJudgements(FlyingScoreEffect* scorePointer, int beforeCut, int afterCu
         char buffer[4]; // Max length for score buffers is 3
         // %b
         sprintf(buffer, "%i", beforeCut);
-        judgement_cs = replace(judgement_cs, createcsstr("%b", 2), createcsstr(buffer, strlen(buffer)));
+        judgement_cs = alloc_replace(&format_replace_site, judgement_cs, alloc_createcsstr(&format_key_site, "%b", 2), alloc_createcsstr(&format_value_site, buffer, strlen(buffer)));
         // %c
         buffer[1] = '\0'; buffer[2] = '\0'; // Reset buffer
         sprintf(buffer, "%i", cutDistance);
-        judgement_cs = replace(judgement_cs, createcsstr("%c", 2), createcsstr(buffer, strlen(buffer)));
+        judgement_cs = alloc_replace(&format_replace_site, judgement_cs, alloc_createcsstr(&format_key_site, "%c", 2), alloc_createcsstr(&format_value_site, buffer, strlen(buffer)));
         // %a
         buffer[1] = '\0'; buffer[2] = '\0'; // Reset buffer
         sprintf(buffer, "%i", afterCut);
-        judgement_cs = replace(judgement_cs, createcsstr("%a", 2), createcsstr(buffer, strlen(buffer)));
+        judgement_cs = alloc_replace(&format_replace_site, judgement_cs, alloc_createcsstr(&format_key_site, "%a", 2), alloc_createcsstr(&format_value_site, buffer, strlen(buffer)));
         // %B
         char* bestBeforeSeg = getBestSegment(beforeCutAngleJudgements, beforeCut_count, beforeCut);
-        judgement_cs = replace(judgement_cs, createcsstr("%B", 2), createcsstr(bestBeforeSeg, strlen(bestBeforeSeg)));
+        judgement_cs = alloc_replace(&format_replace_site, judgement_cs, alloc_createcsstr(&format_key_site, "%B", 2), alloc_createcsstr(&format_value_site, bestBeforeSeg, strlen(bestBeforeSeg)));
         // %C
         char* bestCutAcc = getBestSegment(accuracyJudgements, accuracy_count, cutDistance);
-        judgement_cs = replace(judgement_cs, createcsstr("%C", 2), createcsstr(bestCutAcc, strlen(bestCutAcc)));
+        judgement_cs = alloc_replace(&format_replace_site, judgement_cs, alloc_createcsstr(&format_key_site, "%C", 2), alloc_createcsstr(&format_value_site, bestCutAcc, strlen(bestCutAcc)));
         // %A
         char* bestAfterSeg = getBestSegment(afterCutAngleJudgements, afterCut_count, afterCut);
-        judgement_cs = replace(judgement_cs, createcsstr("%A", 2), createcsstr(bestAfterSeg, strlen(bestAfterSeg)));
+        judgement_cs = alloc_replace(&format_replace_site, judgement_cs, alloc_createcsstr(&format_key_site, "%A", 2), alloc_createcsstr(&format_value_site, bestAfterSeg, strlen(bestAfterSeg)));
         // %s
         buffer[1] = '\0'; buffer[2] = '\0'; // Reset buffer
         sprintf(buffer, "%i", score);
-        judgement_cs = replace(judgement_cs, createcsstr("%s", 2), createcsstr(buffer, strlen(buffer)));
+        judgement_cs = alloc_replace(&format_replace_site, judgement_cs, alloc_createcsstr(&format_key_site, "%s", 2), alloc_createcsstr(&format_value_site, buffer, strlen(buffer)));
         // %p
         char percentBuff[7]; // 6 is upper bound for 100.00 percent
         sprintf(percentBuff, "%.2f", score / 115.0 * 100.0);
-        judgement_cs = replace(judgement_cs, createcsstr("%p", 2), createcsstr(percentBuff, strlen(percentBuff)));
+        judgement_cs = alloc_replace(&format_replace_site, judgement_cs, alloc_createcsstr(&format_key_site, "%p", 2), alloc_createcsstr(&format_value_site, percentBuff, strlen(percentBuff)));
         // %%
-        judgement_cs = replace(judgement_cs, createcsstr("%%", 2), createcsstr("%", 1));
+        judgement_cs = alloc_replace(&format_replace_site, judgement_cs, alloc_createcsstr(&format_key_site, "%%", 2), alloc_createcsstr(&format_value_site, "%", 1));
         // %n
-        judgement_cs = replace(judgement_cs, createcsstr("%n", 2), createcsstr("\n", 1));
+        judgement_cs = alloc_replace(&format_replace_site, judgement_cs, alloc_createcsstr(&format_key_site, "%n", 2), alloc_createcsstr(&format_value_site, "\n", 1));
         newText = judgement_cs;
         break;
     case DISPLAY_MODE_NUMERIC:
@@ -545,18 +552,18 @@ void checkJudgements(FlyingScoreEffect* scorePointer, int beforeCut, int afterCu
         // Score on top
         log("Displaying score on top!");
         // Add newline
-        cs_string* temp = concat(old, createcsstr("\n", 1));
+        cs_string* temp = alloc_concat(&concat_site, old, alloc_createcsstr(&newline_site, "\n", 1));
         log("Attempting to concat old text and judgement text...");
-        newText = concat(temp, judgement_cs);
+        newText = alloc_concat(&concat_site, temp, judgement_cs);
         break;
     case DISPLAY_MODE_TEXTONTOP:
     default:
         // Text on top
         log("Displaying judgement text on top!");
         // Add newline
-        judgement_cs = concat(judgement_cs, createcsstr("\n", 1));
+        judgement_cs = alloc_concat(&concat_site, judgement_cs, alloc_createcsstr(&newline_site, "\n", 1));
         log("Attempting to concat judgement text and old text...");
-        newText = concat(judgement_cs, old);
+        newText = alloc_concat(&concat_site, judgement_cs, old);
         break;
     }
     
@@ -585,35 +592,46 @@ void loadall() {
     }
 }
 
-MAKE_HOOK(raw_score_without_multiplier, RawScoreWithoutMulitplier_offset, void, void* noteCutInfo, void* saberAfterCutSwingRatingCounter, int* beforeCutRawScore, int* afterCutRawScore, int* cutDistanceRawScore) {
-    log("Called RawScoreWithoutMultiplier Hook!");
-    raw_score_without_multiplier(noteCutInfo, saberAfterCutSwingRatingCounter, beforeCutRawScore, afterCutRawScore, cutDistanceRawScore);
-}
-
-MAKE_HOOK(HandleSaberAfterCutSwingRatingCounterDidChangeEvent, HandleSaberAfterCutSwingRatingCounterDidChangeEvent_offset, void, FlyingScoreEffect* self, void* saberAfterCutSwingRatingCounter, float rating) {
-    log("Called HandleSaberAfterCutSwingRatingCounterDidChangeEvent Hook!");
-    log("Attempting to call standard HandleSaberAfterCutSwingRatingCounterDidChangeEvent...");
-    HandleSaberAfterCutSwingRatingCounterDidChangeEvent(self, saberAfterCutSwingRatingCounter, rating);
-    int beforeCut = 0;
-    int afterCut = 0;
-    int cutDistance = 0;
-    raw_score_without_multiplier(self->noteCutInfo, self->saberAfterCutSwingRatingCounter, &beforeCut, &afterCut, &cutDistance);
-    int score = beforeCut + afterCut;
+// Called by GameplayEvents after FlyingScoreEffect.HandleSaberAfterCutSwingRatingCounterDidChangeEvent,
+// with the raw score parts already decoded
+void handleSwingRatingChanged(const gameplay_event_t* event, void* context) {
+    int score = event->before_cut + event->after_cut;
     log("RawScore: %i", score);
     log("Checking judgements...");
-    checkJudgements(self, beforeCut, afterCut, cutDistance);
+    checkJudgements((FlyingScoreEffect*)event->flying_score_effect, event->before_cut, event->after_cut, event->cut_distance);
     log("Completed HandleSaberAfterCutSwingRatingCounterDidChangeEvent!");
 }
 
+// Counts the hits for the allocation report. The swing rating event fires many times per note while the
+// after-cut rating settles, so hits are counted here, once per cut note.
+void handleNoteCut(const gameplay_event_t* event, void* context) {
+    alloc_hit();
+}
+
+// The allocation report follows the song through GameplayEvents, which owns the song and frame hooks
+void handleSongStart(const gameplay_event_t* event, void* context) {
+    alloc_song_start();
+}
+
+void handleScoreFrame(const gameplay_event_t* event, void* context) {
+    alloc_frame();
+}
+
+void handleSongEnd(const gameplay_event_t* event, void* context) {
+    alloc_song_end();
+}
+
 __attribute__((constructor)) void lib_main()
 {
     log("Inserting HitScoreVisualizer...");
     // INSTALL_HOOK(init_and_present);
     // log("Installed InitAndPresent Hook!");
-    INSTALL_HOOK(raw_score_without_multiplier);
-    log("Installed RawScoreWithoutMultiplier Hook!");
-    INSTALL_HOOK(HandleSaberAfterCutSwingRatingCounterDidChangeEvent);
-    log("Installed HandleSaberAfterCutSwingRatingCounterDidChangeEvent Hook!");
+    gameplay_events_subscribe(GAMEPLAY_EVENT_SWING_RATING_CHANGED, 0, GAMEPLAY_NOTE_ANY, GAMEPLAY_SABER_ANY, handleSwingRatingChanged, NULL);
+    gameplay_events_subscribe(GAMEPLAY_EVENT_NOTE_CUT, 0, GAMEPLAY_NOTE_A | GAMEPLAY_NOTE_B, GAMEPLAY_SABER_ANY, handleNoteCut, NULL);
+    gameplay_events_subscribe(GAMEPLAY_EVENT_SONG_START, 0, GAMEPLAY_NOTE_ANY, GAMEPLAY_SABER_ANY, handleSongStart, NULL);
+    gameplay_events_subscribe(GAMEPLAY_EVENT_SCORE_FRAME, 0, GAMEPLAY_NOTE_ANY, GAMEPLAY_SABER_ANY, handleScoreFrame, NULL);
+    gameplay_events_subscribe(GAMEPLAY_EVENT_SONG_END, 0, GAMEPLAY_NOTE_ANY, GAMEPLAY_SABER_ANY, handleSongEnd, NULL);
+    log("Subscribed to swing rating, note cut, song and frame events!");
     // Attempt to add and create judgements
     // Attempt to find judgements
     if (fileexists(CONFIG_FILE) == '\1') {
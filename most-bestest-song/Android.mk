@@ -24,9 +24,16 @@ LOCAL_MODULE := hook
 #LOCAL_SRC_FILES := $(LOCAL_PATH)/../obj/local/armeabi-v7a/libhook.a
 #LOCAL_EXPORT_C_INCLUDES := $(LOCAL_PATH)/../include
 
+# Built by ../core
+include $(CLEAR_VARS)
+LOCAL_MODULE := questhookcore
+LOCAL_SRC_FILES := ../core/libs/$(TARGET_ARCH_ABI)/lib0questhookcore.so
+include $(PREBUILT_SHARED_LIBRARY)
+
 include $(CLEAR_VARS)
 LOCAL_LDLIBS := -llog
 LOCAL_MODULE    := mostbestestsong
-LOCAL_SRC_FILES := main.c ../beatsaber-hook/shared/utils/utils.c ../beatsaber-hook/shared/inline-hook/inlineHook.c ../beatsaber-hook/shared/inline-hook/relocate.c
+LOCAL_SRC_FILES := main.c textpool.c playcount.c ranking.c
+LOCAL_SHARED_LIBRARIES := questhookcore
 #LOCAL_STATIC_LIBRARIES := libhook
 include $(BUILD_SHARED_LIBRARY)
@@ -9,136 +9,176 @@
 #include <linux/limits.h>
 #include <sys/sendfile.h>
 #include <sys/stat.h>
+#include <time.h>
 
-#include "../beatsaber-hook/shared/inline-hook/inlineHook.h"
-#include "../beatsaber-hook/shared/utils/utils.h"
+#include "../core/core.h"
+#include "textpool.h"
+#include "playcount.h"
+#include "ranking.h"
 
 #undef log
 #define log(...) __android_log_print(ANDROID_LOG_INFO, "QuestHook", "[Most-Bestest-Song] " __VA_ARGS__)
 
-// GameObject gameObj = new GameObject("CustomUIText");
-// gameObj.SetActive(false);
-
-// TextMeshProUGUI textMesh = gameObj.AddComponent<TextMeshProUGUI>();
-// What happens if we don't use font? Try and see.
-// textMesh.font = Instantiate(Resources.FindObjectsOfTypeAll<TMP_FontAsset>().First(t => t.name == "Teko-Medium SDF No Glow"));
-// textMesh.rectTransform.SetParent(parent, false);
-// textMesh.text = text;
-// textMesh.fontSize = 4;
-// textMesh.color = Color.white;
-
-// All of these are properties that we need to do set operations on.
-// textMesh.rectTransform.anchorMin = new Vector2(0.5f, 0.5f);
-// textMesh.rectTransform.anchorMax = new Vector2(0.5f, 0.5f);
-// textMesh.rectTransform.sizeDelta = sizeDelta;
-// textMesh.rectTransform.anchoredPosition = anchoredPosition;
-
-// gameObj.SetActive(true);
-// return textMesh;
-
-typedef struct {
-    float x;
-    float y;
-} Vector2;
-
-typedef struct {
-    float r;
-    float g;
-    float b;
-    float a;
-} Color;
-
-void* createText(void* rectTransformParent, char text[], Vector2 anchoredPosition, Vector2 sizeDelta) {
-    log("Creating text: %s", text);
-    /////////////////////////////////////////////////////////////////////////////////////
-    log("Attempting to create new gameobject...");
-    // GameObject.ctor(string name): 0xC7643C
-    void* gameobj = malloc(sizeof(GameObject)); // YIKES!
-    log("Attempting to disable the active state of the gameobject...");
-    // GameObject.SetActive(bool value): 0xC77074
-    void (*set_active)(void*, char) = (void*)getRealOffset(0xC77074);
-    set_active(gameobj, 0x0); // Set active to false, in theory
-    /////////////////////////////////////////////////////////////////////////////////////
-    log("Attempting to add component for TextMeshProUGUI...");
-    // GameObject.AddComponent: 0xC766D0, 0x5BCDA4
-    void* (*add_comp)(void*, void*) = (void*)getRealOffset(0xC766D0);
-    void* textMesh = add_comp(gameobj, /*TODO TYPE OF TEXTMESHPROUGUI */0);
-    //TODO ADD FONT
-    log("Attempting to get RectTransform...");
-    // TextMeshProUGUI.get_rectTransform: (base class, TMP_Text): 0x50FF0C
-    void* (*get_rectTransform)(void*) = (void*)getRealOffset(0x50FF0C);
-    void* rectTransform = get_rectTransform(textMesh);
-    log("Attempting to set RectTransform parent...");
-    // RectTransform.SetParent: (base class, Transform): 0xBEF560
-    void (*setParent)(void*, void*, char) = (void*)getRealOffset(0xBEF560);
-    setParent(rectTransform, rectTransformParent, 0x0); // Set save world pos to false, in theory
-    /////////////////////////////////////////////////////////////////////////////////////
-    log("Attempting to get original text...");
-    // TextMeshProUGUI.get_text: (base class, TMP_Text): 0x510D88
-    cs_string* (*get_text)(void*) = (void*)getRealOffset(0x510D88);
-    cs_string* new_text = get_text(textMesh);
-    char* new_text_real;
-    csstrtostr(new_text, new_text_real);
-    log("Attempting to convert input text: %s", text);
-    // Need to call the setter? hopefully just the getter...
-    strcpy(new_text_real, text);
-    log("Attempting to set font size...");
-    // TextMeshProUGUI.set_fontSize: (base class, TMP_Text): 0x5119A8
-    void (*set_fontSize)(void*, float) = (void*)getRealOffset(0x5119A8);
-    set_fontSize(textMesh, 4.0f);
-    // ENTER THE DANGER ZONE!
-    log("Attempting to set color to white...");
-    // TextMeshProUGUI.set_color: (base class, TMP_Text): 0x51126C
-    // void (*set_color)(void*, Color) = (void*)getRealOffset(0x51126C);
-    // set_color(textMesh, (Color){1.0f, 1.0f, 1.0f, 1.0f});
-    // TextMeshProUGUI.get_color: (base class, TMP_Text): 0x51125C
-    Color (*get_color)(void*) = (void*)getRealOffset(0x51125C);
-    Color m_color = get_color(textMesh);
-    m_color.r = 1.0f;
-    m_color.g = 1.0f;
-    m_color.b = 1.0f;
-    m_color.a = 1.0f;
-
-    log("Attempting to set RectTransform.anchorMin...");
-    // RectTransform.get_anchorMin: 0xC93240 RETURNS STRUCT?
-    Vector2 (*get_anchorMin)(void*) = (void*)getRealOffset(0xC93240);
-    Vector2 m_min = get_anchorMin(rectTransform);
-    log("Attempting to set fields for RectTransform.anchorMin...");
-    m_min->x = 0.5f;
-    m_min->y = 0.5f;
-    log("Attempting to set RectTransform.anchorMax...");
-    // RectTransform.get_anchorMax: 0xC93398 RETURNS STRUCT?
-    Vector2 (*get_anchorMax)(void*) = (void*)getRealOffset(0xC93398);
-    Vector2 m_max = get_anchorMax(rectTransform);
-    log("Attempting to set fields for RectTransform.anchorMax...");
-    m_max.x = 0.5f;
-    m_max.y = 0.5f;
-    log("Attempting to set RectTransform.sizeDelta...");
-    // RectTransform.set_sizeDelta: 0xC93704 REQUIRES STRUCT? STRUCT POINTER?
-    // void (*set_sizeDelta)(void*, Vector2) = (void*)getRealOffset(0xC93704);
-    // set_sizeDelta(rectTransform, sizeDelta);
-    // RectTransform.get_sizeDelta: 0xC93648 RETURNS STRUCT
-    Vector2 (*get_sizeDelta)(void*) = (void*)getRealOffset(0xC93648);
-    Vector2 m_sizeDelta = get_sizeDelta(rectTransform);
-    m_sizeDelta.x = sizeDelta.x;
-    m_sizeDelta.y = sizeDelta.y;
-    log("Attempting to set RectTransform.anchoredPosition...");
-    // RectTransform.set_anchoredPosition: 0xC935AC REQUIRES STRUCT? STRUCT POINTER?
-    // void (*set_anchoredPosition)(void*, Vector2) = (void*)getRealOffset(0xC935AC);
-    // set_anchoredPosition(rectTransform, anchoredPosition);
-    // RectTransform.get_anchoredPosition: 0xC934F0
-    Vector2 (*get_anchoredPosition)(void*) = (void*)getRealOffset(0xC934F0);
-    Vector2 m_anchoredPosition = get_anchoredPosition(rectTransform);
-    m_anchoredPosition.x = anchoredPosition.x;
-    m_anchoredPosition.y = anchoredPosition.y;
-
-    log("Attempting to set game object to be active again...");
-    set_active(gameobj, 0x1);
-    return textMesh;
+// MainMenuViewController.DidActivate: 0x12CA338
+#define MainMenuViewController_DidActivate_offset 0x12CA338
+// LevelPackLevelsViewController.DidActivate: 0x12BE108
+#define LevelPackLevelsViewController_DidActivate_offset 0x12BE108
+// StandardLevelDetailViewController.DidActivate: 0x12EAA78
+#define StandardLevelDetailViewController_DidActivate_offset 0x12EAA78
+
+// PlayerLevelStatsData.get_levelID: 0x475FF4
+#define PlayerLevelStatsData_get_levelID_offset 0x475FF4
+// PlayerLevelStatsData.IncreaseNumberOfGameplays: 0x4773B8
+#define PlayerLevelStatsData_IncreaseNumberOfGameplays_offset 0x4773B8
+// PlayerLevelStatsData.UpdateScoreData(int score, int maxCombo, bool fullCombo, Rank rank): 0x4772D0
+#define PlayerLevelStatsData_UpdateScoreData_offset 0x4772D0
+
+// How many ranked levels the song-stats menu shows per metric
+#define SHOWN_RANKS 3
+// One column per metric: a header label, then a label per ranked level
+#define RANKING_LABELS (PLAYCOUNT_METRIC_COUNT * (SHOWN_RANKS + 1))
+#define RANKING_COLUMN_WIDTH 40.0f
+#define RANKING_ROW_HEIGHT 6.0f
+#define RANKING_TOP 32.0f
+
+static playcount_store_t play_counts;
+// One per metric, kept up to date as levels finish, so the menus never look at the whole store
+static ranking_t rankings[PLAYCOUNT_METRIC_COUNT];
+static const char* const metric_names[PLAYCOUNT_METRIC_COUNT] = { "Most played", "Best score", "Last played" };
+// Pooled labels the rankings are shown with, hidden again before the next view controller shows them
+static void* ranking_labels[RANKING_LABELS];
+static int ranking_label_count = 0;
+
+static void* (*Component_get_transform)(void*) = NULL;
+
+// Level ids are ASCII, anything longer than the store takes is cut off and then not stored
+static void level_id_of(void* playerLevelStatsData, char* level_id) {
+    static cs_string* (*get_levelID)(void*) = NULL;
+    if (!get_levelID) {
+        get_levelID = (void*)getRealOffset(PlayerLevelStatsData_get_levelID_offset);
+    }
+    cs_string* id = get_levelID(playerLevelStatsData);
+    int len = 0;
+    for (; id && len < id->len && len < PLAYCOUNT_LEVEL_ID_SIZE; len++) {
+        level_id[len] = (char)id->str[len];
+    }
+    level_id[len < PLAYCOUNT_LEVEL_ID_SIZE ? len : 0] = '\0';
+}
+
+// A new level starts at 0 for every metric, so it can enter any ranking that is not full yet
+static void update_rankings(const playcount_entry_t* entry) {
+    for (int metric = 0; metric < PLAYCOUNT_METRIC_COUNT; metric++) {
+        ranking_update(&rankings[metric], entry);
+    }
+}
+
+// "2. custom_level_0123abcd: 14 plays". Custom level ids end in a 40 character hash, 8 are enough to tell
+// them apart.
+static void format_row(char* row, size_t size, int rank, playcount_metric_t metric, const ranking_node_t* node) {
+    const char* custom = "custom_level_";
+    int id_len = strncmp(node->level_id, custom, strlen(custom)) == 0 ? (int)strlen(custom) + 8 : PLAYCOUNT_LEVEL_ID_SIZE;
+    if (metric == PLAYCOUNT_LAST_PLAYED) {
+        char date[16];
+        time_t played = (time_t)node->value;
+        strftime(date, sizeof(date), "%Y-%m-%d", localtime(&played));
+        snprintf(row, size, "%i. %.*s: %s", rank, id_len, node->level_id, date);
+    } else {
+        snprintf(row, size, "%i. %.*s: %lld%s", rank, id_len, node->level_id, (long long)node->value, metric == PLAYCOUNT_MOST_PLAYED ? " plays" : "");
+    }
+}
+
+static void show_label(void* parent, const char* text, int column, int row) {
+    Vector2 position = { (column - (PLAYCOUNT_METRIC_COUNT - 1) / 2.0f) * RANKING_COLUMN_WIDTH, RANKING_TOP - row * RANKING_ROW_HEIGHT };
+    void* label = text_pool_show(parent, text, position, (Vector2){ RANKING_COLUMN_WIDTH, RANKING_ROW_HEIGHT });
+    if (label) {
+        ranking_labels[ranking_label_count++] = label;
+    }
+}
+
+// Shows the rankings under the view controller with pooled labels. Reading them is O(K) per metric, they
+// are only sorted again after a level finished. Labels that show the same text as last time skip set_text.
+static void show_rankings(void* viewController) {
+    for (int i = 0; i < ranking_label_count; i++) {
+        text_pool_hide(ranking_labels[i]);
+    }
+    ranking_label_count = 0;
+    if (!Component_get_transform) {
+        return;
+    }
+    void* parent = Component_get_transform(viewController);
+    char row[96];
+    for (int metric = 0; metric < PLAYCOUNT_METRIC_COUNT; metric++) {
+        const ranking_node_t* ranked;
+        int count = ranking_read(&rankings[metric], &ranked);
+        show_label(parent, metric_names[metric], metric, 0);
+        for (int i = 0; i < count && i < SHOWN_RANKS; i++) {
+            format_row(row, sizeof(row), i + 1, metric, &ranked[i]);
+            show_label(parent, row, metric, i + 1);
+        }
+    }
+}
+
+// The game calls this once per finished level, for every level and difficulty
+MAKE_HOOK(PlayerLevelStatsData_IncreaseNumberOfGameplays, PlayerLevelStatsData_IncreaseNumberOfGameplays_offset, void, void* self) {
+    PlayerLevelStatsData_IncreaseNumberOfGameplays(self);
+    char level_id[PLAYCOUNT_LEVEL_ID_SIZE + 1];
+    level_id_of(self, level_id);
+    const playcount_entry_t* entry = playcount_record_play(&play_counts, level_id, time(NULL));
+    if (entry) {
+        log("%s played %u times", entry->level_id, entry->play_count);
+        update_rankings(entry);
+    }
+}
+
+MAKE_HOOK(PlayerLevelStatsData_UpdateScoreData, PlayerLevelStatsData_UpdateScoreData_offset, void, void* self, int score, int maxCombo, char fullCombo, int rank) {
+    PlayerLevelStatsData_UpdateScoreData(self, score, maxCombo, fullCombo, rank);
+    char level_id[PLAYCOUNT_LEVEL_ID_SIZE + 1];
+    level_id_of(self, level_id);
+    const playcount_entry_t* entry = playcount_record_score(&play_counts, level_id, score);
+    if (entry) {
+        update_rankings(entry);
+    }
+}
+
+MAKE_HOOK(LevelPackLevelsViewController_DidActivate, LevelPackLevelsViewController_DidActivate_offset, void, void* self, char firstActivation, int activationType) {
+    LevelPackLevelsViewController_DidActivate(self, firstActivation, activationType);
+    show_rankings(self);
+}
+
+MAKE_HOOK(StandardLevelDetailViewController_DidActivate, StandardLevelDetailViewController_DidActivate_offset, void, void* self, char firstActivation, int activationType) {
+    StandardLevelDetailViewController_DidActivate(self, firstActivation, activationType);
+    show_rankings(self);
+}
+
+MAKE_HOOK(MainMenuViewController_DidActivate, MainMenuViewController_DidActivate_offset, void, void* self, char firstActivation, int activationType) {
+    MainMenuViewController_DidActivate(self, firstActivation, activationType);
+    if (!firstActivation) {
+        return;
+    }
+    if (!Component_get_transform) {
+        Component_get_transform = core_il2cpp_method("UnityEngine.CoreModule", "UnityEngine", "Component", "get_transform", 0);
+    }
+    if (Component_get_transform) {
+        // The menu's labels are created here, before any are shown. A reloaded menu gets a new pool, the
+        // labels the rankings used went with the old scene.
+        ranking_label_count = 0;
+        text_pool_init(Component_get_transform(self));
+    }
 }
 
 __attribute__((constructor)) void lib_main()
 {
+    // Replays what the last session logged, before any level can finish
+    playcount_open(&play_counts, PLAYCOUNT_MAP_FILE, PLAYCOUNT_LOG_FILE);
+    // The only full pass over the store, from here on the rankings follow each change
+    for (int metric = 0; metric < PLAYCOUNT_METRIC_COUNT; metric++) {
+        ranking_init(&rankings[metric], metric, &play_counts);
+    }
     log("Installing Most-Bestest-Song hooks...");
+    INSTALL_HOOK(MainMenuViewController_DidActivate);
+    INSTALL_HOOK(PlayerLevelStatsData_IncreaseNumberOfGameplays);
+    INSTALL_HOOK(PlayerLevelStatsData_UpdateScoreData);
+    INSTALL_HOOK(LevelPackLevelsViewController_DidActivate);
+    INSTALL_HOOK(StandardLevelDetailViewController_DidActivate);
     log("Completed installing hooks!");
-}
\ No newline at end of file
+}
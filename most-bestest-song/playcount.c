@@ -0,0 +1,312 @@
+#include <android/log.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "playcount.h"
+
+#undef log
+#define log(...) __android_log_print(ANDROID_LOG_INFO, "QuestHook", "[Most-Bestest-Song] " __VA_ARGS__)
+
+// The map grows when more than this many slots in 16 are used
+#define PLAYCOUNT_MAX_LOAD 11
+
+// One log record: the entry's value after the change
+typedef struct playcount_log_record {
+    uint32_t checksum;
+    uint32_t size;
+    playcount_entry_t entry;
+} playcount_log_record_t;
+
+static uint32_t fnv1a(const void* data, size_t len) {
+    const uint8_t* p = data;
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ p[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static size_t map_size(uint32_t capacity) {
+    return sizeof(playcount_header_t) + (size_t)capacity * sizeof(playcount_entry_t);
+}
+
+// Maps the file, creating an empty map with the capacity if it has no valid one. Returns 0 on success.
+static int map_file(playcount_store_t* store, int fd, uint32_t capacity) {
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        return -1;
+    }
+    playcount_header_t header;
+    char valid = st.st_size >= (off_t)sizeof(header) && pread(fd, &header, sizeof(header), 0) == sizeof(header)
+        && header.magic == PLAYCOUNT_MAGIC && header.version == PLAYCOUNT_VERSION && header.entry_size == sizeof(playcount_entry_t)
+        && header.capacity > 0 && (header.capacity & (header.capacity - 1)) == 0 && st.st_size == (off_t)map_size(header.capacity);
+    if (!valid) {
+        if (st.st_size > 0) {
+            log("Play count map is not valid, starting a new one!");
+        }
+        memset(&header, 0, sizeof(header));
+        header.magic = PLAYCOUNT_MAGIC;
+        header.version = PLAYCOUNT_VERSION;
+        header.entry_size = sizeof(playcount_entry_t);
+        header.capacity = capacity;
+        // Zero filled, so every slot is empty
+        if (ftruncate(fd, 0) != 0 || ftruncate(fd, map_size(capacity)) != 0 || pwrite(fd, &header, sizeof(header), 0) != sizeof(header)) {
+            return -1;
+        }
+    }
+    size_t size = map_size(header.capacity);
+    void* map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        return -1;
+    }
+    store->map_fd = fd;
+    store->map_size = size;
+    store->header = map;
+    store->entries = (playcount_entry_t*)((uint8_t*)map + sizeof(playcount_header_t));
+    return 0;
+}
+
+// The level's slot, or the empty slot it would go in
+static playcount_entry_t* find_slot(const playcount_store_t* store, const char* level_id) {
+    uint32_t mask = store->header->capacity - 1;
+    uint32_t i = fnv1a(level_id, strlen(level_id)) & mask;
+    while (store->entries[i].level_id[0] != '\0' && strcmp(store->entries[i].level_id, level_id) != 0) {
+        i = (i + 1) & mask;
+    }
+    return &store->entries[i];
+}
+
+// Moves every entry into a map twice the size, written next to the old one and renamed over it
+static int grow(playcount_store_t* store) {
+    char temp[PATH_MAX];
+    snprintf(temp, sizeof(temp), "%s.tmp", store->map_path);
+    int fd = open(temp, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return -1;
+    }
+    playcount_store_t grown = *store;
+    if (map_file(&grown, fd, store->header->capacity * 2) != 0) {
+        close(fd);
+        remove(temp);
+        return -1;
+    }
+    for (uint32_t i = 0; i < store->header->capacity; i++) {
+        if (store->entries[i].level_id[0] != '\0') {
+            *find_slot(&grown, store->entries[i].level_id) = store->entries[i];
+        }
+    }
+    grown.header->count = store->header->count;
+    if (msync(grown.header, grown.map_size, MS_SYNC) != 0 || rename(temp, store->map_path) != 0) {
+        munmap(grown.header, grown.map_size);
+        close(fd);
+        remove(temp);
+        return -1;
+    }
+    munmap(store->header, store->map_size);
+    close(store->map_fd);
+    *store = grown;
+    return 0;
+}
+
+// The level's slot, taking an empty one for a new level. NULL if the id does not fit or the map can not grow.
+static playcount_entry_t* get_or_add(playcount_store_t* store, const char* level_id) {
+    if (level_id[0] == '\0' || strlen(level_id) >= PLAYCOUNT_LEVEL_ID_SIZE) {
+        return NULL;
+    }
+    playcount_entry_t* entry = find_slot(store, level_id);
+    if (entry->level_id[0] != '\0') {
+        return entry;
+    }
+    if ((store->header->count + 1) * 16 > store->header->capacity * PLAYCOUNT_MAX_LOAD) {
+        if (grow(store) != 0) {
+            log("Could not grow the play count map!");
+            return NULL;
+        }
+        entry = find_slot(store, level_id);
+    }
+    strcpy(entry->level_id, level_id);
+    store->header->count++;
+    return entry;
+}
+
+static void append_log(playcount_store_t* store, const playcount_entry_t* entry) {
+    playcount_log_record_t record;
+    record.size = sizeof(playcount_entry_t);
+    record.entry = *entry;
+    record.checksum = fnv1a(&record.entry, sizeof(record.entry));
+    // O_APPEND, so a record is never interleaved. A torn last record fails its checksum on replay.
+    if (write(store->log_fd, &record, sizeof(record)) != sizeof(record)) {
+        log("Could not append to the play count log!");
+    }
+}
+
+// Applies every complete record in the log, then empties it. Returns the number applied.
+static int replay_log(playcount_store_t* store) {
+    playcount_log_record_t record;
+    int applied = 0;
+    off_t offset = 0;
+    while (pread(store->log_fd, &record, sizeof(record), offset) == sizeof(record)) {
+        if (record.size != sizeof(playcount_entry_t) || record.checksum != fnv1a(&record.entry, sizeof(record.entry))) {
+            log("Play count log has a bad record at %lld, ignoring the rest", (long long)offset);
+            break;
+        }
+        record.entry.level_id[PLAYCOUNT_LEVEL_ID_SIZE - 1] = '\0';
+        playcount_entry_t* entry = get_or_add(store, record.entry.level_id);
+        if (entry) {
+            *entry = record.entry;
+            applied++;
+        }
+        offset += sizeof(record);
+    }
+    // The map has to be on disk before the log is gone
+    if (msync(store->header, store->map_size, MS_SYNC) == 0) {
+        ftruncate(store->log_fd, 0);
+    }
+    return applied;
+}
+
+int playcount_open(playcount_store_t* store, const char* map_path, const char* log_path) {
+    memset(store, 0, sizeof(*store));
+    store->map_fd = -1;
+    store->log_fd = -1;
+    store->map_path = map_path;
+    int fd = open(map_path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        log("Could not open the play count map at path: %s", map_path);
+        return -1;
+    }
+    if (map_file(store, fd, PLAYCOUNT_INITIAL_CAPACITY) != 0) {
+        log("Could not map the play count map at path: %s", map_path);
+        close(fd);
+        return -1;
+    }
+    store->log_fd = open(log_path, O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (store->log_fd < 0) {
+        log("Could not open the play count log at path: %s", log_path);
+        playcount_close(store);
+        return -1;
+    }
+    int applied = replay_log(store);
+    log("Play counts: %u levels, %i log records applied", store->header->count, applied);
+    return 0;
+}
+
+void playcount_close(playcount_store_t* store) {
+    if (store->header) {
+        munmap(store->header, store->map_size);
+    }
+    if (store->map_fd >= 0) {
+        close(store->map_fd);
+    }
+    if (store->log_fd >= 0) {
+        close(store->log_fd);
+    }
+    memset(store, 0, sizeof(*store));
+    store->map_fd = -1;
+    store->log_fd = -1;
+}
+
+const playcount_entry_t* playcount_get(const playcount_store_t* store, const char* level_id) {
+    if (!store->header || strlen(level_id) >= PLAYCOUNT_LEVEL_ID_SIZE) {
+        return NULL;
+    }
+    const playcount_entry_t* entry = find_slot(store, level_id);
+    return entry->level_id[0] != '\0' ? entry : NULL;
+}
+
+const playcount_entry_t* playcount_record_play(playcount_store_t* store, const char* level_id, int64_t time) {
+    playcount_entry_t* entry = store->header ? get_or_add(store, level_id) : NULL;
+    if (entry) {
+        entry->play_count++;
+        entry->last_played = time;
+        append_log(store, entry);
+    }
+    return entry;
+}
+
+const playcount_entry_t* playcount_record_score(playcount_store_t* store, const char* level_id, int score) {
+    playcount_entry_t* entry = store->header ? get_or_add(store, level_id) : NULL;
+    if (entry && score > entry->best_score) {
+        entry->best_score = score;
+        append_log(store, entry);
+    }
+    return entry;
+}
+
+int64_t playcount_metric_value(const playcount_entry_t* entry, playcount_metric_t metric) {
+    switch (metric) {
+    case PLAYCOUNT_MOST_PLAYED:
+        return entry->play_count;
+    case PLAYCOUNT_BEST_SCORE:
+        return entry->best_score;
+    default:
+        return entry->last_played;
+    }
+}
+
+// Whether a ranks below b. Ties go by level id, so the order is stable.
+static char ranks_below(const playcount_entry_t* a, const playcount_entry_t* b, playcount_metric_t metric) {
+    int64_t x = playcount_metric_value(a, metric);
+    int64_t y = playcount_metric_value(b, metric);
+    return x < y || (x == y && strcmp(a->level_id, b->level_id) > 0);
+}
+
+static void sift_down(const playcount_entry_t** heap, int count, int i, playcount_metric_t metric) {
+    while (1) {
+        int lowest = i;
+        int left = 2 * i + 1;
+        int right = left + 1;
+        if (left < count && ranks_below(heap[left], heap[lowest], metric)) {
+            lowest = left;
+        }
+        if (right < count && ranks_below(heap[right], heap[lowest], metric)) {
+            lowest = right;
+        }
+        if (lowest == i) {
+            return;
+        }
+        const playcount_entry_t* swap = heap[i];
+        heap[i] = heap[lowest];
+        heap[lowest] = swap;
+        i = lowest;
+    }
+}
+
+int playcount_top(const playcount_store_t* store, playcount_metric_t metric, int k, const playcount_entry_t** out) {
+    if (!store->header || k <= 0) {
+        return 0;
+    }
+    // out is a min-heap of the best k so far, its root is the one to beat
+    int count = 0;
+    for (uint32_t i = 0; i < store->header->capacity; i++) {
+        const playcount_entry_t* entry = &store->entries[i];
+        if (entry->level_id[0] == '\0') {
+            continue;
+        }
+        if (count < k) {
+            out[count++] = entry;
+            for (int j = count - 1; j > 0 && ranks_below(out[j], out[(j - 1) / 2], metric); j = (j - 1) / 2) {
+                const playcount_entry_t* swap = out[j];
+                out[j] = out[(j - 1) / 2];
+                out[(j - 1) / 2] = swap;
+            }
+        } else if (ranks_below(out[0], entry, metric)) {
+            out[0] = entry;
+            sift_down(out, count, 0, metric);
+        }
+    }
+    // Pop the lowest to the back, leaving the best first
+    for (int end = count - 1; end > 0; end--) {
+        const playcount_entry_t* swap = out[0];
+        out[0] = out[end];
+        out[end] = swap;
+        sift_down(out, end, 0, metric);
+    }
+    return count;
+}
@@ -0,0 +1,74 @@
+#ifndef PLAYCOUNT_H
+#define PLAYCOUNT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Persistent play counts per level. The store is an open addressing hash map (linear probing, level id
+// keys) in a memory mapped file, so opening it reads nothing and a lookup touches one or two pages.
+// Every change is also appended to a log as the entry's new value. A crash loses nothing the log has, the
+// next open replays the log into the map (replaying a record twice is harmless) and empties it.
+// Nothing here calls into the game, so it runs on host too.
+
+#define PLAYCOUNT_MAP_FILE "/sdcard/Android/data/com.beatgames.beatsaber/files/mods/MostBestestSongPlayCounts.map"
+#define PLAYCOUNT_LOG_FILE "/sdcard/Android/data/com.beatgames.beatsaber/files/mods/MostBestestSongPlayCounts.log"
+
+#define PLAYCOUNT_MAGIC 0x544E4350 // "PCNT"
+#define PLAYCOUNT_VERSION 1
+// Custom level ids are "custom_level_" and a 40 character hash
+#define PLAYCOUNT_LEVEL_ID_SIZE 80
+// Slots in a new map, always a power of two
+#define PLAYCOUNT_INITIAL_CAPACITY 1024
+
+// Part of the file format, only fixed size fields
+typedef struct playcount_entry {
+    // Empty slots start with '\0'
+    char level_id[PLAYCOUNT_LEVEL_ID_SIZE];
+    uint32_t play_count;
+    int32_t best_score;
+    // Seconds since the epoch
+    int64_t last_played;
+} playcount_entry_t;
+
+_Static_assert(sizeof(playcount_entry_t) == 96, "playcount_entry_t is part of the file format");
+
+typedef struct playcount_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entry_size;
+    uint32_t capacity;
+    uint32_t count;
+    uint32_t reserved[3];
+} playcount_header_t;
+
+typedef enum playcount_metric {
+    PLAYCOUNT_MOST_PLAYED,
+    PLAYCOUNT_BEST_SCORE,
+    PLAYCOUNT_LAST_PLAYED,
+    PLAYCOUNT_METRIC_COUNT
+} playcount_metric_t;
+
+typedef struct playcount_store {
+    int map_fd;
+    int log_fd;
+    playcount_header_t* header;
+    playcount_entry_t* entries;
+    size_t map_size;
+    const char* map_path;
+} playcount_store_t;
+
+// Maps the store (creating it if needed), replays and empties the log. Returns 0 on success.
+int playcount_open(playcount_store_t* store, const char* map_path, const char* log_path);
+void playcount_close(playcount_store_t* store);
+// The level's entry, or NULL if it was never played. Valid until the next change to the store.
+const playcount_entry_t* playcount_get(const playcount_store_t* store, const char* level_id);
+// Counts a play of the level. Returns the updated entry, or NULL on failure.
+const playcount_entry_t* playcount_record_play(playcount_store_t* store, const char* level_id, int64_t time);
+// Keeps the score if it is the level's best. Returns the updated entry, or NULL on failure.
+const playcount_entry_t* playcount_record_score(playcount_store_t* store, const char* level_id, int score);
+// The entry's value for the metric, higher ranks better
+int64_t playcount_metric_value(const playcount_entry_t* entry, playcount_metric_t metric);
+// Writes the k best levels by the metric to out, best first. Returns how many were written.
+int playcount_top(const playcount_store_t* store, playcount_metric_t metric, int k, const playcount_entry_t** out);
+
+#endif /* PLAYCOUNT_H */
@@ -0,0 +1,96 @@
+#include <string.h>
+
+#include "ranking.h"
+
+// Same order as playcount_top: by value, ties by level id
+static char ranks_below(const ranking_node_t* a, const ranking_node_t* b) {
+    return a->value < b->value || (a->value == b->value && strcmp(a->level_id, b->level_id) > 0);
+}
+
+static void swap_nodes(ranking_node_t* a, ranking_node_t* b) {
+    ranking_node_t swap = *a;
+    *a = *b;
+    *b = swap;
+}
+
+static void sift_up(ranking_t* ranking, int i) {
+    while (i > 0 && ranks_below(&ranking->heap[i], &ranking->heap[(i - 1) / 2])) {
+        swap_nodes(&ranking->heap[i], &ranking->heap[(i - 1) / 2]);
+        i = (i - 1) / 2;
+    }
+}
+
+static void sift_down(ranking_t* ranking, int i) {
+    while (1) {
+        int lowest = i;
+        int left = 2 * i + 1;
+        int right = left + 1;
+        if (left < ranking->count && ranks_below(&ranking->heap[left], &ranking->heap[lowest])) {
+            lowest = left;
+        }
+        if (right < ranking->count && ranks_below(&ranking->heap[right], &ranking->heap[lowest])) {
+            lowest = right;
+        }
+        if (lowest == i) {
+            return;
+        }
+        swap_nodes(&ranking->heap[i], &ranking->heap[lowest]);
+        i = lowest;
+    }
+}
+
+void ranking_init(ranking_t* ranking, playcount_metric_t metric, const playcount_store_t* store) {
+    memset(ranking, 0, sizeof(*ranking));
+    ranking->metric = metric;
+    const playcount_entry_t* top[RANKING_SIZE];
+    int count = playcount_top(store, metric, RANKING_SIZE, top);
+    for (int i = 0; i < count; i++) {
+        ranking_node_t* node = &ranking->heap[ranking->count++];
+        strcpy(node->level_id, top[i]->level_id);
+        node->value = playcount_metric_value(top[i], metric);
+        sift_up(ranking, ranking->count - 1);
+    }
+}
+
+void ranking_update(ranking_t* ranking, const playcount_entry_t* entry) {
+    ranking_node_t candidate;
+    strcpy(candidate.level_id, entry->level_id);
+    candidate.value = playcount_metric_value(entry, ranking->metric);
+    for (int i = 0; i < ranking->count; i++) {
+        if (strcmp(ranking->heap[i].level_id, candidate.level_id) == 0) {
+            if (ranking->heap[i].value != candidate.value) {
+                // Only ever goes up, so it can only move away from the root
+                ranking->heap[i].value = candidate.value;
+                sift_down(ranking, i);
+                ranking->sorted_valid = '\0';
+            }
+            return;
+        }
+    }
+    if (ranking->count < RANKING_SIZE) {
+        ranking->heap[ranking->count++] = candidate;
+        sift_up(ranking, ranking->count - 1);
+        ranking->sorted_valid = '\0';
+    } else if (ranks_below(&ranking->heap[0], &candidate)) {
+        ranking->heap[0] = candidate;
+        sift_down(ranking, 0);
+        ranking->sorted_valid = '\0';
+    }
+}
+
+int ranking_read(ranking_t* ranking, const ranking_node_t** out) {
+    if (!ranking->sorted_valid) {
+        // Insertion sort, best first. K is small and this only runs after a level finished.
+        for (int i = 0; i < ranking->count; i++) {
+            ranking_node_t node = ranking->heap[i];
+            int j = i;
+            for (; j > 0 && ranks_below(&ranking->sorted[j - 1], &node); j--) {
+                ranking->sorted[j] = ranking->sorted[j - 1];
+            }
+            ranking->sorted[j] = node;
+        }
+        ranking->sorted_valid = '\1';
+    }
+    *out = ranking->sorted;
+    return ranking->count;
+}
@@ -0,0 +1,39 @@
+#ifndef RANKING_H
+#define RANKING_H
+
+#include "playcount.h"
+
+// The best RANKING_SIZE levels by one metric, kept up to date as levels finish instead of being found in
+// the whole store every time a menu opens. Every metric only grows (play count, best score, last played),
+// so a level can only enter the ranking by beating its lowest level, and a level in the ranking can only
+// move up. That makes a min-heap of RANKING_SIZE levels enough: an update is a look at the root and a sift,
+// O(log K), however many levels the store has. Reading sorts the heap only if it changed since the last
+// read, so showing the ranking again is a copy of K levels.
+// Only used on the main thread.
+
+#define RANKING_SIZE 10
+
+typedef struct ranking_node {
+    // A copy, entries move when the store grows
+    char level_id[PLAYCOUNT_LEVEL_ID_SIZE];
+    int64_t value;
+} ranking_node_t;
+
+typedef struct ranking {
+    playcount_metric_t metric;
+    int count;
+    // Min-heap, the root is the level to beat
+    ranking_node_t heap[RANKING_SIZE];
+    // Best first, valid when sorted_valid is set
+    ranking_node_t sorted[RANKING_SIZE];
+    char sorted_valid;
+} ranking_t;
+
+// Fills the ranking from the store, one pass over all levels
+void ranking_init(ranking_t* ranking, playcount_metric_t metric, const playcount_store_t* store);
+// Called after the entry changed. Its value for the metric must not have gone down.
+void ranking_update(ranking_t* ranking, const playcount_entry_t* entry);
+// Points out at the ranked levels, best first. Returns how many there are.
+int ranking_read(ranking_t* ranking, const ranking_node_t** out);
+
+#endif /* RANKING_H */
@@ -0,0 +1,198 @@
+#include <android/log.h>
+#include <string.h>
+
+#include "textpool.h"
+
+#undef log
+#define log(...) __android_log_print(ANDROID_LOG_INFO, "QuestHook", "[Most-Bestest-Song] " __VA_ARGS__)
+
+// GameObject.ctor(string name): 0xC7643C
+#define GameObject_ctor_offset 0xC7643C
+// GameObject.SetActive(bool value): 0xC77074
+#define GameObject_SetActive_offset 0xC77074
+// GameObject.AddComponent(Type componentType): 0xC766D0
+#define GameObject_AddComponent_offset 0xC766D0
+// TextMeshProUGUI.get_rectTransform (base class, TMP_Text): 0x50FF0C
+#define TMP_Text_get_rectTransform_offset 0x50FF0C
+// RectTransform.SetParent (base class, Transform): 0xBEF560
+#define Transform_SetParent_offset 0xBEF560
+// TextMeshProUGUI.set_text (base class, TMP_Text): 0x510D90
+#define TMP_Text_set_text_offset 0x510D90
+// TextMeshProUGUI.set_fontSize (base class, TMP_Text): 0x5119A8
+#define TMP_Text_set_fontSize_offset 0x5119A8
+// TextMeshProUGUI.set_color (base class, TMP_Text): 0x51126C
+#define TMP_Text_set_color_offset 0x51126C
+// RectTransform.set_sizeDelta: 0xC93704
+#define RectTransform_set_sizeDelta_offset 0xC93704
+// RectTransform.set_anchoredPosition: 0xC935AC
+#define RectTransform_set_anchoredPosition_offset 0xC935AC
+
+#define TEXT_FONT_SIZE 4.0f
+// Texts up to this long are remembered, showing the same text again does not create a string
+#define TEXT_CACHE_SIZE 128
+
+typedef struct text_pool_entry {
+    void* game_object;
+    void* text_mesh;
+    void* rect_transform;
+    // What the label was last set to, so showing it again skips the calls that would not change anything
+    void* parent;
+    Vector2 anchored_position;
+    Vector2 size_delta;
+    char text[TEXT_CACHE_SIZE];
+    char in_use;
+    uint32_t handle;
+} text_pool_entry_t;
+
+static text_pool_entry_t entries[TEXT_POOL_MAX];
+static int entry_count = 0;
+static void* pool_parent = NULL;
+
+static void (*GameObject_ctor)(void*, cs_string*) = NULL;
+static void (*GameObject_SetActive)(void*, char) = NULL;
+static void* (*GameObject_AddComponent)(void*, void*) = NULL;
+static void* (*TMP_Text_get_rectTransform)(void*) = NULL;
+static void (*Transform_SetParent)(void*, void*, char) = NULL;
+static void (*TMP_Text_set_text)(void*, cs_string*) = NULL;
+static void (*TMP_Text_set_fontSize)(void*, float) = NULL;
+static void (*TMP_Text_set_color)(void*, Color) = NULL;
+static void (*RectTransform_set_sizeDelta)(void*, Vector2) = NULL;
+static void (*RectTransform_set_anchoredPosition)(void*, Vector2) = NULL;
+// No known offsets
+static void (*RectTransform_set_anchorMin)(void*, Vector2) = NULL;
+static void (*RectTransform_set_anchorMax)(void*, Vector2) = NULL;
+static void* text_mesh_type = NULL;
+
+static char resolve_methods() {
+    if (text_mesh_type) {
+        return '\1';
+    }
+    GameObject_ctor = (void*)getRealOffset(GameObject_ctor_offset);
+    GameObject_SetActive = (void*)getRealOffset(GameObject_SetActive_offset);
+    GameObject_AddComponent = (void*)getRealOffset(GameObject_AddComponent_offset);
+    TMP_Text_get_rectTransform = (void*)getRealOffset(TMP_Text_get_rectTransform_offset);
+    Transform_SetParent = (void*)getRealOffset(Transform_SetParent_offset);
+    TMP_Text_set_text = (void*)getRealOffset(TMP_Text_set_text_offset);
+    TMP_Text_set_fontSize = (void*)getRealOffset(TMP_Text_set_fontSize_offset);
+    TMP_Text_set_color = (void*)getRealOffset(TMP_Text_set_color_offset);
+    RectTransform_set_sizeDelta = (void*)getRealOffset(RectTransform_set_sizeDelta_offset);
+    RectTransform_set_anchoredPosition = (void*)getRealOffset(RectTransform_set_anchoredPosition_offset);
+    RectTransform_set_anchorMin = core_il2cpp_method("UnityEngine.CoreModule", "UnityEngine", "RectTransform", "set_anchorMin", 1);
+    RectTransform_set_anchorMax = core_il2cpp_method("UnityEngine.CoreModule", "UnityEngine", "RectTransform", "set_anchorMax", 1);
+    if (!RectTransform_set_anchorMin || !RectTransform_set_anchorMax) {
+        return '\0';
+    }
+    text_mesh_type = core_il2cpp_type_object("Unity.TextMeshPro", "TMPro", "TextMeshProUGUI");
+    return text_mesh_type != NULL;
+}
+
+// Everything a label needs that does not depend on what it shows, done once per label
+static text_pool_entry_t* create_entry(void* parent) {
+    if (entry_count == TEXT_POOL_MAX) {
+        return NULL;
+    }
+    void* game_object = core_il2cpp_object_new("UnityEngine.CoreModule", "UnityEngine", "GameObject");
+    if (!game_object) {
+        return NULL;
+    }
+    GameObject_ctor(game_object, createcsstr("CustomUIText", 12));
+    GameObject_SetActive(game_object, '\0');
+    void* text_mesh = GameObject_AddComponent(game_object, text_mesh_type);
+    if (!text_mesh) {
+        return NULL;
+    }
+    text_pool_entry_t* entry = &entries[entry_count++];
+    memset(entry, 0, sizeof(*entry));
+    entry->game_object = game_object;
+    entry->handle = core_il2cpp_keep_alive(game_object);
+    entry->text_mesh = text_mesh;
+    entry->rect_transform = TMP_Text_get_rectTransform(text_mesh);
+    entry->parent = parent;
+    Transform_SetParent(entry->rect_transform, parent, '\0');
+    TMP_Text_set_fontSize(text_mesh, TEXT_FONT_SIZE);
+    TMP_Text_set_color(text_mesh, (Color){1.0f, 1.0f, 1.0f, 1.0f});
+    RectTransform_set_anchorMin(entry->rect_transform, (Vector2){0.5f, 0.5f});
+    RectTransform_set_anchorMax(entry->rect_transform, (Vector2){0.5f, 0.5f});
+    // Set on first show
+    entry->anchored_position = (Vector2){-1e9f, -1e9f};
+    entry->size_delta = (Vector2){-1e9f, -1e9f};
+    return entry;
+}
+
+int text_pool_init(void* rectTransformParent) {
+    if (rectTransformParent == pool_parent && entry_count > 0) {
+        return 0;
+    }
+    if (!resolve_methods()) {
+        log("Could not resolve the text methods, no text pool!");
+        return -1;
+    }
+    for (int i = 0; i < entry_count; i++) {
+        core_il2cpp_release(entries[i].handle);
+    }
+    entry_count = 0;
+    pool_parent = rectTransformParent;
+    for (int i = 0; i < TEXT_POOL_SIZE; i++) {
+        if (!create_entry(rectTransformParent)) {
+            log("Could only create %i pooled texts!", entry_count);
+            return -1;
+        }
+    }
+    log("Created %i pooled texts", entry_count);
+    return 0;
+}
+
+void* text_pool_show(void* rectTransformParent, const char* text, Vector2 anchoredPosition, Vector2 sizeDelta) {
+    if (!text_mesh_type) {
+        return NULL;
+    }
+    text_pool_entry_t* entry = NULL;
+    for (int i = 0; i < entry_count; i++) {
+        if (!entries[i].in_use) {
+            entry = &entries[i];
+            break;
+        }
+    }
+    if (!entry) {
+        entry = create_entry(rectTransformParent);
+        if (!entry) {
+            log("All %i pooled texts are in use!", entry_count);
+            return NULL;
+        }
+        log("Grew the text pool to %i", entry_count);
+    }
+    entry->in_use = '\1';
+    if (entry->parent != rectTransformParent) {
+        Transform_SetParent(entry->rect_transform, rectTransformParent, '\0');
+        entry->parent = rectTransformParent;
+    }
+    if (entry->anchored_position.x != anchoredPosition.x || entry->anchored_position.y != anchoredPosition.y) {
+        RectTransform_set_anchoredPosition(entry->rect_transform, anchoredPosition);
+        entry->anchored_position = anchoredPosition;
+    }
+    if (entry->size_delta.x != sizeDelta.x || entry->size_delta.y != sizeDelta.y) {
+        RectTransform_set_sizeDelta(entry->rect_transform, sizeDelta);
+        entry->size_delta = sizeDelta;
+    }
+    size_t len = strlen(text);
+    if (len >= TEXT_CACHE_SIZE || strcmp(entry->text, text) != 0) {
+        TMP_Text_set_text(entry->text_mesh, createcsstr(text, len));
+        if (len < TEXT_CACHE_SIZE) {
+            memcpy(entry->text, text, len + 1);
+        } else {
+            entry->text[0] = '\0';
+        }
+    }
+    GameObject_SetActive(entry->game_object, '\1');
+    return entry->text_mesh;
+}
+
+void text_pool_hide(void* textMesh) {
+    for (int i = 0; i < entry_count; i++) {
+        if (entries[i].text_mesh == textMesh) {
+            GameObject_SetActive(entries[i].game_object, '\0');
+            entries[i].in_use = '\0';
+            return;
+        }
+    }
+}
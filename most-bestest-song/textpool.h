@@ -0,0 +1,29 @@
+#ifndef TEXTPOOL_H
+#define TEXTPOOL_H
+
+#include "../core/core.h"
+
+// Pool of TextMeshProUGUI labels. Creating a label is a GameObject, an AddComponent and a managed call per
+// property, so all of that happens once, when the menu loads. Showing a label after that takes a free one
+// and sets its text, and its parent, position and size only if they changed.
+// Only used on the main thread.
+
+typedef struct {
+    float x;
+    float y;
+} Vector2;
+
+// Labels created when the menu loads
+#define TEXT_POOL_SIZE 16
+// The pool grows to this many when all labels are in use
+#define TEXT_POOL_MAX 64
+
+// Creates TEXT_POOL_SIZE inactive labels under the parent. Calling it again with another parent (the menu
+// was loaded again) drops the old labels, Unity destroyed them with their scene. Returns 0 on success.
+int text_pool_init(void* rectTransformParent);
+// Shows a free label with the text, returns its TextMeshProUGUI or NULL if there is none
+void* text_pool_show(void* rectTransformParent, const char* text, Vector2 anchoredPosition, Vector2 sizeDelta);
+// Hides a label and returns it to the pool
+void text_pool_hide(void* textMesh);
+
+#endif /* TEXTPOOL_H */
@@ -3753,9 +3753,12 @@ typedef struct __attribute__((__packed__)) ScoreController {
 	int _combo;
 	int _maxCombo;
 	char _feverIsActive;
+	// il2cpp aligns the fields after a bool, the dump is packed
+	char _padding_feverIsActive[3];
 	float _feverStartTime;
 	int _feverCombo;
 	char _playerHeadWasInObstacle;
+	char _padding_playerHeadWasInObstacle[3];
 	int _immediateMaxPossibleRawScore;
 	int _cutOrMissedNotes;
 	void* _afterCutScoreBuffers;
@@ -4687,6 +4690,8 @@ typedef struct __attribute__((__packed__)) LIV {
 	void* TrackedSpaceOrigin;
 	void* HMDCamera;
 	char DisableStandardAssets;
+	// il2cpp aligns the fields after a bool, the dump is packed
+	char _padding_DisableStandardAssets[3];
 	struct LayerMask SpectatorLayerMask;
 } LIV_t;
 typedef struct __attribute__((__packed__)) SmoothCameraController {
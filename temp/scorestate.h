@@ -0,0 +1,72 @@
+#ifndef SCORESTATE_H
+#define SCORESTATE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "../beatsaber-hook/shared/utils/utils.h"
+#include "main.h"
+
+// Read-only ScoreController accessors that read the fields straight from object memory instead of
+// calling the managed getters. Nothing is copied or allocated, and they are safe to call from any hook
+// that has the ScoreController pointer.
+// Offsets are the il2cpp field offsets from the dump (armeabi-v7a). Every one is checked at compile time
+// against the layout in main.h, so a regenerated main.h that moves a field fails to build instead of
+// reading the wrong memory.
+
+#define SCORE_STATE_FIELD(type, name, field, offset) \
+_Static_assert(offsetof(ScoreController_t, field) == (offset), "ScoreController." #field " is not at " #offset ", update scorestate.h"); \
+_Static_assert(sizeof(((ScoreController_t*)0)->field) == sizeof(type), "ScoreController." #field " changed type, update scorestate.h"); \
+static inline type score_controller_ ## name(const struct ScoreController* self) { \
+    return *(const type*)((const uint8_t*)self + (offset)); \
+}
+
+SCORE_STATE_FIELD(int, base_raw_score, _baseRawScore, 0x4C)
+SCORE_STATE_FIELD(int, prev_frame_raw_score, _prevFrameRawScore, 0x50)
+SCORE_STATE_FIELD(int, multiplier, _multiplier, 0x54)
+SCORE_STATE_FIELD(int, multiplier_increase_progress, _multiplierIncreaseProgress, 0x58)
+SCORE_STATE_FIELD(int, multiplier_increase_max_progress, _multiplierIncreaseMaxProgress, 0x5C)
+SCORE_STATE_FIELD(int, combo, _combo, 0x60)
+SCORE_STATE_FIELD(int, max_combo, _maxCombo, 0x64)
+SCORE_STATE_FIELD(char, fever_is_active, _feverIsActive, 0x68)
+SCORE_STATE_FIELD(float, fever_start_time, _feverStartTime, 0x6C)
+SCORE_STATE_FIELD(int, fever_combo, _feverCombo, 0x70)
+SCORE_STATE_FIELD(char, player_head_was_in_obstacle, _playerHeadWasInObstacle, 0x74)
+SCORE_STATE_FIELD(int, immediate_max_possible_raw_score, _immediateMaxPossibleRawScore, 0x78)
+SCORE_STATE_FIELD(int, cut_or_missed_notes, _cutOrMissedNotes, 0x7C)
+SCORE_STATE_FIELD(float, gameplay_modifiers_score_multiplier, _gameplayModifiersScoreMultiplier, 0x84)
+
+// The hot fields, copied out once per frame for mods that read them many times
+typedef struct score_snapshot {
+    int base_raw_score;
+    int prev_frame_raw_score;
+    int immediate_max_possible_raw_score;
+    int multiplier;
+    int multiplier_increase_progress;
+    int multiplier_increase_max_progress;
+    int combo;
+    int max_combo;
+    int fever_combo;
+    int cut_or_missed_notes;
+    float gameplay_modifiers_score_multiplier;
+    char fever_is_active;
+    char player_head_was_in_obstacle;
+} score_snapshot_t;
+
+// Fills in the snapshot from the ScoreController, e.g. from a ScoreController.LateUpdate hook
+static inline void score_controller_snapshot(const struct ScoreController* self, score_snapshot_t* snapshot) {
+    snapshot->base_raw_score = score_controller_base_raw_score(self);
+    snapshot->prev_frame_raw_score = score_controller_prev_frame_raw_score(self);
+    snapshot->immediate_max_possible_raw_score = score_controller_immediate_max_possible_raw_score(self);
+    snapshot->multiplier = score_controller_multiplier(self);
+    snapshot->multiplier_increase_progress = score_controller_multiplier_increase_progress(self);
+    snapshot->multiplier_increase_max_progress = score_controller_multiplier_increase_max_progress(self);
+    snapshot->combo = score_controller_combo(self);
+    snapshot->max_combo = score_controller_max_combo(self);
+    snapshot->fever_combo = score_controller_fever_combo(self);
+    snapshot->cut_or_missed_notes = score_controller_cut_or_missed_notes(self);
+    snapshot->gameplay_modifiers_score_multiplier = score_controller_gameplay_modifiers_score_multiplier(self);
+    snapshot->fever_is_active = score_controller_fever_is_active(self);
+    snapshot->player_head_was_in_obstacle = score_controller_player_head_was_in_obstacle(self);
+}
+
+#endif /* SCORESTATE_H */
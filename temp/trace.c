@@ -0,0 +1,958 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <linux/limits.h>
+
+#include "trace.h"
+#include "tracecompress.h"
+
+#ifdef __ANDROID__
+#include <android/log.h>
+#define trace_log(...) __android_log_print(ANDROID_LOG_INFO, "QuestHook", "[Trace] " __VA_ARGS__)
+#else
+#define trace_log(...) (fprintf(stderr, "[Trace] " __VA_ARGS__), fputc('\n', stderr))
+#endif
+
+typedef struct trace_frame {
+    trace_hook_t* hook;
+    uint64_t start;
+    uint64_t children;
+} trace_frame_t;
+
+// Shadow stack of the timed hooks currently executing on a thread
+typedef struct trace_stack {
+    int depth;
+    // Frames pushed past TRACE_MAX_DEPTH are only counted, so enters and exits stay balanced
+    int overflow;
+    trace_frame_t frames[TRACE_MAX_DEPTH];
+} trace_stack_t;
+
+// Single producer, single consumer ring of raw records. Only the owning thread writes records,
+// only the flush thread reads them, so neither side ever waits for the other.
+// The cursors and the data live in the shared mapping (see trace_live_header_t), the rest is private.
+typedef struct trace_buffer {
+    trace_thread_t* thread;
+    uint8_t* data;
+    // Flush thread only
+    uint64_t reported;
+    trace_stack_t stack;
+} trace_buffer_t;
+
+// Flight recorder: records go to a fixed size ring instead of the trace file.
+// When a frame goes over the threshold, the records from `window` before the frame
+// until `window` after it are copied out and written to their own file.
+// Only touched by the flush thread, which moves records here from the thread buffers.
+typedef struct trace_flight {
+    char enabled;
+    uint64_t threshold;
+    uint64_t window;
+    uint8_t* ring;
+    uint64_t size;
+    // Positions only ever increase, the ring offset is position % size
+    uint64_t head;
+    uint64_t tail;
+    // Set while waiting for `window` to pass after a slow frame
+    char armed;
+    uint64_t from;
+    uint64_t until;
+    uint32_t frame;
+    uint8_t* dump;
+    uint64_t dump_size;
+    uint64_t last_frame;
+    // Thread records are only written once per thread, so every dump repeats them
+    trace_record_header_t threads[TRACE_MAX_THREADS];
+    uint8_t thread_flags[TRACE_MAX_THREADS];
+    int thread_count;
+} trace_flight_t;
+
+// State of the compressed file, only touched with trace_writer_lock held
+typedef struct trace_writer {
+    uint8_t raw[TRACE_BLOCK_SIZE + TRACE_MAX_RECORD_ENCODED];
+    uint8_t compressed[TRACE_LZ4_BOUND(TRACE_BLOCK_SIZE + TRACE_MAX_RECORD_ENCODED)];
+    int len;
+    uint32_t records;
+    uint64_t base;
+    uint64_t previous;
+    uint64_t min;
+    uint64_t max;
+    // Where the next block goes, the index footer is always written here too
+    uint64_t offset;
+    trace_index_entry_t* index;
+    uint32_t index_count;
+    uint32_t index_capacity;
+} trace_writer_t;
+
+uint32_t trace_enabled[TRACE_MAX_HOOKS / 32];
+
+static FILE* trace_file = NULL;
+static pthread_mutex_t trace_writer_lock = PTHREAD_MUTEX_INITIALIZER;
+static trace_writer_t trace_writer;
+static trace_buffer_t trace_buffers[TRACE_MAX_THREADS];
+// Stored as the thread's buffer when every buffer is taken, its records are dropped
+static trace_buffer_t trace_buffer_none;
+static pthread_key_t trace_buffer_key;
+// Mapping that holds the hook table, the thread cursors and the thread buffers, NULL until trace_init
+static trace_live_header_t* trace_live = NULL;
+static trace_live_hook_t* trace_live_hooks = NULL;
+static trace_flight_t trace_flight;
+static trace_hook_t* trace_hooks[TRACE_MAX_HOOKS];
+static int trace_hook_count = 0;
+static pthread_t trace_flush_thread;
+static uint32_t trace_frame_count = 0;
+static time_t trace_control_mtime = 0;
+// Empty unless TempTrace.cfg has a "live" line
+static char trace_live_path[PATH_MAX] = "";
+
+static void trace_poll_control(const char* path);
+
+static uint64_t trace_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void trace_ring_copy_out(const uint8_t* ring, uint64_t size, uint8_t* dst, uint64_t pos, uint64_t len) {
+    uint64_t offset = pos % size;
+    uint64_t first = len < size - offset ? len : size - offset;
+    memcpy(dst, ring + offset, first);
+    memcpy(dst + first, ring, len - first);
+}
+
+static void trace_ring_copy_in(uint8_t* ring, uint64_t size, uint64_t pos, const void* src, uint64_t len) {
+    uint64_t offset = pos % size;
+    uint64_t first = len < size - offset ? len : size - offset;
+    memcpy(ring + offset, src, first);
+    memcpy(ring, (const uint8_t*)src + first, len - first);
+}
+
+static uint32_t trace_gettid() {
+#ifdef __ANDROID__
+    // Bionic caches the tid in the thread's pthread struct, no syscall
+    return (uint32_t)gettid();
+#else
+    return (uint32_t)syscall(SYS_gettid);
+#endif
+}
+
+// Copies the records in [from, until] out of the ring
+static void trace_flight_freeze() {
+    trace_flight.armed = '\0';
+    uint64_t out = 0;
+    uint64_t pos = trace_flight.tail;
+    trace_record_header_t header;
+    while (pos < trace_flight.head) {
+        trace_ring_copy_out(trace_flight.ring, trace_flight.size, (uint8_t*)&header, pos, sizeof(header));
+        uint64_t len = sizeof(header) + header.size;
+        if (header.timestamp >= trace_flight.from && header.timestamp <= trace_flight.until) {
+            trace_ring_copy_out(trace_flight.ring, trace_flight.size, trace_flight.dump + out, pos, len);
+            out += len;
+        }
+        pos += len;
+    }
+    trace_flight.dump_size = out;
+}
+
+// Appends a record to the ring, dropping the oldest records to make room
+static void trace_flight_write(const trace_record_header_t* header, const void* payload) {
+    uint64_t len = sizeof(*header) + header->size;
+    while (trace_flight.head + len - trace_flight.tail > trace_flight.size) {
+        trace_record_header_t oldest;
+        trace_ring_copy_out(trace_flight.ring, trace_flight.size, (uint8_t*)&oldest, trace_flight.tail, sizeof(oldest));
+        trace_flight.tail += sizeof(oldest) + oldest.size;
+    }
+    trace_ring_copy_in(trace_flight.ring, trace_flight.size, trace_flight.head, header, sizeof(*header));
+    if (header->size > 0) {
+        trace_ring_copy_in(trace_flight.ring, trace_flight.size, trace_flight.head + sizeof(*header), payload, header->size);
+    }
+    trace_flight.head += len;
+}
+
+// Checks the length of the frame that just ended
+static void trace_flight_frame(uint32_t frame, uint64_t timestamp) {
+    uint64_t start = trace_flight.last_frame;
+    trace_flight.last_frame = timestamp;
+    if (start == 0 || trace_flight.armed || timestamp - start < trace_flight.threshold) {
+        return;
+    }
+    trace_flight.armed = '\1';
+    trace_flight.from = start > trace_flight.window ? start - trace_flight.window : 0;
+    trace_flight.until = timestamp + trace_flight.window;
+    trace_flight.frame = frame - 1;
+}
+
+static void trace_write_file_header(FILE* f, uint32_t version) {
+    trace_file_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TRACE_MAGIC, sizeof(TRACE_MAGIC));
+    header.version = version;
+    fwrite(&header, sizeof(header), 1, f);
+}
+
+// Builds the payload of a TRACE_RECORD_HOOKDEF record, returns its length
+static int trace_hookdef(trace_hook_t* hook, char* payload, int size) {
+    uint32_t offset = (uint32_t)hook->offset;
+    int nameLen = strlen(hook->name) + 1;
+    int sigLen = strlen(hook->signature) + 1;
+    if ((int)sizeof(offset) + nameLen + sigLen > size) {
+        sigLen = 1;
+    }
+    memcpy(payload, &offset, sizeof(offset));
+    memcpy(payload + sizeof(offset), hook->name, nameLen);
+    memcpy(payload + sizeof(offset) + nameLen, sigLen > 1 ? hook->signature : "", sigLen);
+    return sizeof(offset) + nameLen + sigLen;
+}
+
+static void trace_flight_save() {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), TRACE_FLIGHT_FILE, trace_flight.frame);
+    FILE* f = fopen(path, "wb");
+    if (!f) {
+        trace_log("Could not open flight recorder dump at path: %s", path);
+        return;
+    }
+    trace_write_file_header(f, TRACE_VERSION_RAW);
+    // Hook definitions are not kept in the ring, so every dump gets all of them
+    char payload[1024];
+    for (int i = 0; i < trace_hook_count; i++) {
+        trace_record_header_t header;
+        memset(&header, 0, sizeof(header));
+        header.hook = trace_hooks[i]->id;
+        header.type = TRACE_RECORD_HOOKDEF;
+        header.size = trace_hookdef(trace_hooks[i], payload, sizeof(payload));
+        fwrite(&header, sizeof(header), 1, f);
+        fwrite(payload, header.size, 1, f);
+    }
+    for (int i = 0; i < trace_flight.thread_count; i++) {
+        fwrite(&trace_flight.threads[i], sizeof(trace_record_header_t), 1, f);
+        fwrite(&trace_flight.thread_flags[i], 1, 1, f);
+    }
+    fwrite(trace_flight.dump, trace_flight.dump_size, 1, f);
+    fclose(f);
+    trace_log("Wrote flight recorder dump for frame %u to: %s", trace_flight.frame, path);
+}
+
+// Rewrites the index footer after the last block. Must hold trace_writer_lock.
+static void trace_writer_footer() {
+    trace_file_footer_t footer;
+    footer.index_offset = trace_writer.offset;
+    footer.block_count = trace_writer.index_count;
+    memcpy(footer.magic, TRACE_FOOTER_MAGIC, sizeof(footer.magic));
+    fseek(trace_file, trace_writer.offset, SEEK_SET);
+    fwrite(trace_writer.index, sizeof(trace_index_entry_t), trace_writer.index_count, trace_file);
+    fwrite(&footer, sizeof(footer), 1, trace_file);
+    // Truncate anything left from an older, longer footer
+    fflush(trace_file);
+    if (ftruncate(fileno(trace_file), ftell(trace_file)) != 0) {
+        trace_log("Could not truncate trace file!");
+    }
+}
+
+// Compresses and writes the current block. Must hold trace_writer_lock.
+static void trace_writer_block() {
+    if (trace_writer.records == 0) {
+        return;
+    }
+    trace_block_header_t header;
+    memcpy(header.magic, TRACE_BLOCK_MAGIC, sizeof(header.magic));
+    header.raw_size = trace_writer.len;
+    header.records = trace_writer.records;
+    header.base_timestamp = trace_writer.base;
+    header.min_timestamp = trace_writer.min;
+    header.max_timestamp = trace_writer.max;
+    int compressed = trace_lz4_compress(trace_writer.raw, trace_writer.len, trace_writer.compressed);
+    const uint8_t* data = trace_writer.compressed;
+    header.flags = 0;
+    if (compressed >= trace_writer.len) {
+        // Incompressible, store it as is
+        header.flags = TRACE_BLOCK_STORED;
+        compressed = trace_writer.len;
+        data = trace_writer.raw;
+    }
+    header.stored_size = compressed;
+
+    if (trace_writer.index_count == trace_writer.index_capacity) {
+        trace_writer.index_capacity = trace_writer.index_capacity ? trace_writer.index_capacity * 2 : 1024;
+        trace_writer.index = realloc(trace_writer.index, trace_writer.index_capacity * sizeof(trace_index_entry_t));
+    }
+    trace_index_entry_t* entry = &trace_writer.index[trace_writer.index_count++];
+    entry->offset = trace_writer.offset;
+    entry->min_timestamp = trace_writer.min;
+    entry->max_timestamp = trace_writer.max;
+
+    fseek(trace_file, trace_writer.offset, SEEK_SET);
+    fwrite(&header, sizeof(header), 1, trace_file);
+    fwrite(data, compressed, 1, trace_file);
+    trace_writer.offset += sizeof(header) + compressed;
+    trace_writer.len = 0;
+    trace_writer.records = 0;
+}
+
+// Encodes one staged record into the current block. Must hold trace_writer_lock.
+static void trace_writer_record(const trace_record_header_t* header, const uint8_t* payload) {
+    if (trace_writer.records == 0) {
+        trace_writer.base = header->timestamp;
+        trace_writer.previous = header->timestamp;
+        trace_writer.min = header->timestamp;
+        trace_writer.max = header->timestamp;
+    }
+    uint8_t* dst = trace_writer.raw + trace_writer.len;
+    int n = 0;
+    n += trace_varint_put(dst + n, header->type);
+    n += trace_varint_put(dst + n, header->hook);
+    n += trace_varint_put(dst + n, header->tid);
+    // Records from different threads can be staged slightly out of order, so deltas are signed
+    n += trace_varint_put(dst + n, trace_zigzag((int64_t)(header->timestamp - trace_writer.previous)));
+    n += trace_varint_put(dst + n, header->size);
+    memcpy(dst + n, payload, header->size);
+    n += header->size;
+    trace_writer.len += n;
+    trace_writer.records++;
+    trace_writer.previous = header->timestamp;
+    if (header->timestamp < trace_writer.min) {
+        trace_writer.min = header->timestamp;
+    }
+    if (header->timestamp > trace_writer.max) {
+        trace_writer.max = header->timestamp;
+    }
+    if (trace_writer.len >= TRACE_BLOCK_SIZE) {
+        trace_writer_block();
+    }
+}
+
+// Claims a free buffer for the calling thread. Every buffer is tried once, so this never waits.
+static trace_buffer_t* trace_claim_buffer() {
+    for (int i = 0; i < TRACE_MAX_THREADS; i++) {
+        trace_buffer_t* buffer = &trace_buffers[i];
+        trace_thread_t* thread = buffer->thread;
+        uint32_t expected = TRACE_THREAD_STATE_FREE;
+        if (__atomic_compare_exchange_n(&thread->state, &expected, TRACE_THREAD_STATE_CLAIMED, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            thread->tid = trace_gettid();
+            thread->flags = 0;
+            __atomic_store_n(&thread->state, TRACE_THREAD_STATE_USED, __ATOMIC_RELEASE);
+            pthread_setspecific(trace_buffer_key, buffer);
+            return buffer;
+        }
+    }
+    pthread_setspecific(trace_buffer_key, &trace_buffer_none);
+    return &trace_buffer_none;
+}
+
+// Destructor of trace_buffer_key, runs when a thread exits
+static void trace_release_buffer(void* value) {
+    trace_buffer_t* buffer = value;
+    if (buffer != &trace_buffer_none) {
+        __atomic_store_n(&buffer->thread->state, TRACE_THREAD_STATE_RELEASED, __ATOMIC_RELEASE);
+    }
+}
+
+// Returns the calling thread's buffer, or NULL if tracing is not set up or every buffer is taken
+static trace_buffer_t* trace_get_buffer() {
+    if (!__atomic_load_n(&trace_live, __ATOMIC_ACQUIRE)) {
+        return NULL;
+    }
+    trace_buffer_t* buffer = pthread_getspecific(trace_buffer_key);
+    if (!buffer) {
+        buffer = trace_claim_buffer();
+    }
+    return buffer != &trace_buffer_none ? buffer : NULL;
+}
+
+// Appends a record to the thread's own buffer. Records that do not fit are dropped and counted.
+static void trace_buffer_write(trace_buffer_t* buffer, uint16_t hook, uint8_t type, const void* payload, uint16_t size, uint64_t timestamp) {
+    trace_thread_t* thread = buffer->thread;
+    uint64_t len = sizeof(trace_record_header_t) + size;
+    uint64_t head = thread->head;
+    if (head + len - __atomic_load_n(&thread->tail, __ATOMIC_ACQUIRE) > TRACE_BUFFER_SIZE) {
+        __atomic_store_n(&thread->dropped, thread->dropped + 1, __ATOMIC_RELAXED);
+        return;
+    }
+    trace_record_header_t header;
+    header.hook = hook;
+    header.type = type;
+    header.flags = 0;
+    header.size = size;
+    header.reserved = 0;
+    header.tid = thread->tid;
+    header.timestamp = timestamp;
+    trace_ring_copy_in(buffer->data, TRACE_BUFFER_SIZE, head, &header, sizeof(header));
+    if (size > 0) {
+        trace_ring_copy_in(buffer->data, TRACE_BUFFER_SIZE, head + sizeof(header), payload, size);
+    }
+    __atomic_store_n(&thread->head, head + len, __ATOMIC_RELEASE);
+}
+
+static void trace_pop(trace_stack_t* stack, uint64_t now) {
+    trace_frame_t* frame = &stack->frames[--stack->depth];
+    uint64_t duration = now - frame->start;
+    uint64_t self = duration > frame->children ? duration - frame->children : 0;
+    trace_hook_t* hook = frame->hook;
+    hook->calls++;
+    hook->exclusive += self;
+    // Recursive calls only count towards inclusive time once, at the outermost frame
+    char outermost = '\1';
+    for (int i = 0; i < stack->depth; i++) {
+        if (stack->frames[i].hook == hook) {
+            outermost = '\0';
+            break;
+        }
+    }
+    if (outermost) {
+        hook->inclusive += duration;
+    }
+    if (stack->depth > 0) {
+        stack->frames[stack->depth - 1].children += duration;
+    }
+}
+
+// Replays an enter or exit record on the shadow stack of the thread that wrote it. Must hold trace_writer_lock.
+static void trace_time(trace_stack_t* stack, const trace_record_header_t* header) {
+    trace_hook_t* hook = trace_hooks[header->hook];
+    if (header->type == TRACE_RECORD_ENTER) {
+        if (stack->depth < TRACE_MAX_DEPTH) {
+            trace_frame_t* frame = &stack->frames[stack->depth++];
+            frame->hook = hook;
+            frame->start = header->timestamp;
+            frame->children = 0;
+        } else {
+            stack->overflow++;
+        }
+        return;
+    }
+    if (stack->overflow > 0) {
+        stack->overflow--;
+        return;
+    }
+    // Frames above the matching one never saw their exit (e.g. timing was enabled mid call, or records were dropped), close them here
+    int match = stack->depth - 1;
+    while (match >= 0 && stack->frames[match].hook != hook) {
+        match--;
+    }
+    if (match < 0) {
+        return;
+    }
+    while (stack->depth > match) {
+        trace_pop(stack, header->timestamp);
+    }
+}
+
+// Hands one drained record to the flight ring or the compressed writer. Must hold trace_writer_lock.
+static void trace_consume(trace_buffer_t* buffer, const trace_record_header_t* header, const uint8_t* payload) {
+    if (header->hook >= trace_hook_count) {
+        return;
+    }
+    if (header->type == TRACE_RECORD_ENTER || header->type == TRACE_RECORD_EXIT) {
+        trace_time(&buffer->stack, header);
+    }
+    if (trace_flight.enabled) {
+        if (header->type == TRACE_RECORD_FRAME && header->size >= sizeof(uint32_t)) {
+            uint32_t frame;
+            memcpy(&frame, payload, sizeof(frame));
+            trace_flight_frame(frame, header->timestamp);
+        }
+        if (header->type == TRACE_RECORD_THREAD && header->size >= 1 && trace_flight.thread_count < TRACE_MAX_THREADS) {
+            trace_flight.threads[trace_flight.thread_count] = *header;
+            trace_flight.threads[trace_flight.thread_count].size = 1;
+            trace_flight.thread_flags[trace_flight.thread_count++] = payload[0];
+        }
+        trace_flight_write(header, payload);
+    } else if (trace_file) {
+        trace_writer_record(header, payload);
+    }
+}
+
+// Moves everything the threads have written so far out of their buffers, merging the buffers
+// in timestamp order so the trace stays sorted. Must hold trace_writer_lock.
+static void trace_drain() {
+    trace_buffer_t* buffers[TRACE_MAX_THREADS];
+    char released[TRACE_MAX_THREADS];
+    uint64_t heads[TRACE_MAX_THREADS];
+    uint64_t tails[TRACE_MAX_THREADS];
+    trace_record_header_t next[TRACE_MAX_THREADS];
+    int count = 0;
+    for (int i = 0; i < TRACE_MAX_THREADS; i++) {
+        trace_buffer_t* buffer = &trace_buffers[i];
+        // Read the state before the head, so a released buffer is only freed once its last record was seen
+        uint32_t state = __atomic_load_n(&buffer->thread->state, __ATOMIC_ACQUIRE);
+        if (state != TRACE_THREAD_STATE_USED && state != TRACE_THREAD_STATE_RELEASED) {
+            continue;
+        }
+        buffers[count] = buffer;
+        released[count] = state == TRACE_THREAD_STATE_RELEASED;
+        heads[count] = __atomic_load_n(&buffer->thread->head, __ATOMIC_ACQUIRE);
+        tails[count] = buffer->thread->tail;
+        if (tails[count] < heads[count]) {
+            trace_ring_copy_out(buffer->data, TRACE_BUFFER_SIZE, (uint8_t*)&next[count], tails[count], sizeof(trace_record_header_t));
+        }
+        count++;
+    }
+    uint8_t payload[TRACE_MAX_ARGS_SIZE];
+    while (1) {
+        int oldest = -1;
+        for (int i = 0; i < count; i++) {
+            if (tails[i] < heads[i] && (oldest < 0 || next[i].timestamp < next[oldest].timestamp)) {
+                oldest = i;
+            }
+        }
+        if (oldest < 0) {
+            break;
+        }
+        trace_buffer_t* buffer = buffers[oldest];
+        trace_record_header_t* header = &next[oldest];
+        if (header->size <= sizeof(payload)) {
+            trace_ring_copy_out(buffer->data, TRACE_BUFFER_SIZE, payload, tails[oldest] + sizeof(*header), header->size);
+            trace_consume(buffer, header, payload);
+        }
+        tails[oldest] += sizeof(*header) + header->size;
+        if (tails[oldest] < heads[oldest]) {
+            trace_ring_copy_out(buffer->data, TRACE_BUFFER_SIZE, (uint8_t*)header, tails[oldest], sizeof(*header));
+        }
+    }
+    for (int i = 0; i < count; i++) {
+        trace_buffer_t* buffer = buffers[i];
+        __atomic_store_n(&buffer->thread->tail, tails[i], __ATOMIC_RELEASE);
+        uint64_t dropped = __atomic_load_n(&buffer->thread->dropped, __ATOMIC_RELAXED);
+        if (dropped != buffer->reported) {
+            trace_log("Dropped %llu records from thread %u, its buffer was full", (unsigned long long)(dropped - buffer->reported), buffer->thread->tid);
+            buffer->reported = dropped;
+        }
+        if (released[i]) {
+            memset(&buffer->stack, 0, sizeof(buffer->stack));
+            __atomic_store_n(&buffer->thread->state, TRACE_THREAD_STATE_FREE, __ATOMIC_RELEASE);
+        }
+    }
+}
+
+static void* trace_flush_loop(void* arg) {
+    uint64_t next = trace_now() + TRACE_FLUSH_INTERVAL_MS * 1000000ull;
+    while (1) {
+        struct timespec delay = { 0, TRACE_DRAIN_INTERVAL_MS * 1000000l };
+        nanosleep(&delay, NULL);
+        uint64_t now = trace_now();
+        char interval = now >= next;
+        char saved = '\0';
+        pthread_mutex_lock(&trace_writer_lock);
+        trace_drain();
+        if (trace_flight.armed && now > trace_flight.until) {
+            // Everything written before the window closed has been drained
+            trace_flight_freeze();
+            trace_flight_save();
+            saved = '\1';
+        }
+        if (trace_file && interval) {
+            // Close the block so everything drained is on disk, readable through the index
+            trace_writer_block();
+            trace_writer_footer();
+        }
+        pthread_mutex_unlock(&trace_writer_lock);
+        // The flight recorder only touches the sdcard when it saves a spike, the stats go with the dump
+        if (trace_flight.enabled ? saved : interval) {
+            trace_write_stats(TRACE_STATS_FILE);
+        }
+        if (interval) {
+            trace_poll_control(TRACE_CONTROL_FILE);
+            next += TRACE_FLUSH_INTERVAL_MS * 1000000ull;
+        }
+    }
+    return NULL;
+}
+
+// Reads "flight <threshold_ms> <window_ms> <buffer_kb>" and "live [path]" from the config, if present
+static void trace_load_mode(const char* config) {
+    FILE* f = fopen(config, "r");
+    if (!f) {
+        return;
+    }
+    char line[256];
+    float threshold;
+    int window;
+    int buffer = TRACE_FLIGHT_DEFAULT_BUFFER_KB;
+    while (fgets(line, sizeof(line), f)) {
+        char path[PATH_MAX];
+        if (strncmp(line, "live", 4) == 0 && (line[4] == '\0' || line[4] == '\n' || line[4] == '\r' || line[4] == ' ')) {
+            if (sscanf(line, "live %4095s", path) == 1) {
+                snprintf(trace_live_path, sizeof(trace_live_path), "%s", path);
+            } else {
+                snprintf(trace_live_path, sizeof(trace_live_path), "%s", TRACE_LIVE_FILE);
+            }
+        }
+        if (sscanf(line, "flight %f %i %i", &threshold, &window, &buffer) >= 2) {
+            trace_flight.enabled = '\1';
+            trace_flight.threshold = (uint64_t)(threshold * 1e6);
+            trace_flight.window = (uint64_t)window * 1000000ull;
+            trace_flight.size = (uint64_t)(buffer < 64 ? 64 : buffer) * 1024;
+        }
+    }
+    fclose(f);
+}
+
+// Lays out the hook table, thread cursors and thread buffers in one mapping. It is backed by the file at
+// `path` so other processes can read it, or is anonymous when `path` is empty. Every page is touched here,
+// so recording never takes a page fault for a fresh page.
+static trace_live_header_t* trace_map_live(const char* path) {
+    uint64_t hooks_offset = TRACE_LIVE_PAGE;
+    uint64_t threads_offset = hooks_offset + (uint64_t)TRACE_MAX_HOOKS * sizeof(trace_live_hook_t);
+    uint64_t buffers_offset = (threads_offset + TRACE_MAX_THREADS * sizeof(trace_thread_t) + TRACE_LIVE_PAGE - 1) & ~(uint64_t)(TRACE_LIVE_PAGE - 1);
+    uint64_t size = buffers_offset + (uint64_t)TRACE_MAX_THREADS * TRACE_BUFFER_SIZE;
+    void* map = MAP_FAILED;
+    if (path[0]) {
+        int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd >= 0 && ftruncate(fd, size) == 0) {
+            map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+        if (map == MAP_FAILED) {
+            trace_log("Could not map live trace at path: %s", path);
+        } else {
+            trace_log("Exporting live trace to: %s", path);
+        }
+    }
+    if (map == MAP_FAILED) {
+        map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    }
+    if (map == MAP_FAILED) {
+        return NULL;
+    }
+    memset(map, 0, size);
+    trace_live_header_t* live = map;
+    live->version = TRACE_LIVE_VERSION;
+    live->thread_count = TRACE_MAX_THREADS;
+    live->buffer_size = TRACE_BUFFER_SIZE;
+    live->hook_capacity = TRACE_MAX_HOOKS;
+    live->hooks_offset = hooks_offset;
+    live->threads_offset = threads_offset;
+    live->buffers_offset = buffers_offset;
+    // Readers check the magic first, so it is written last
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(live->magic, TRACE_LIVE_MAGIC, sizeof(TRACE_LIVE_MAGIC));
+    return live;
+}
+
+int trace_init(const char* path, const char* config) {
+    trace_load_mode(config);
+    if (trace_flight.enabled) {
+        trace_flight.ring = malloc(trace_flight.size);
+        trace_flight.dump = malloc(trace_flight.size);
+        if (!trace_flight.ring || !trace_flight.dump) {
+            trace_log("Could not allocate %llu byte flight recorder!", (unsigned long long)trace_flight.size);
+            return -1;
+        }
+        trace_log("Flight recorder enabled: %.1f ms threshold, %llu ms window, %llu KB buffer", trace_flight.threshold / 1e6,
+            (unsigned long long)(trace_flight.window / 1000000), (unsigned long long)(trace_flight.size / 1024));
+    } else {
+        FILE* f = fopen(path, "wb");
+        if (!f) {
+            trace_log("Could not open trace file at path: %s", path);
+            return -1;
+        }
+        trace_write_file_header(f, TRACE_VERSION_COMPRESSED);
+        trace_writer.offset = sizeof(trace_file_header_t);
+        trace_file = f;
+        trace_log("Writing trace to: %s", path);
+    }
+    trace_live_header_t* live = trace_map_live(trace_live_path);
+    if (!live || pthread_key_create(&trace_buffer_key, trace_release_buffer) != 0) {
+        trace_log("Could not allocate trace buffers!");
+        return -1;
+    }
+    trace_thread_t* threads = (trace_thread_t*)((uint8_t*)live + live->threads_offset);
+    for (int i = 0; i < TRACE_MAX_THREADS; i++) {
+        trace_buffers[i].thread = &threads[i];
+        trace_buffers[i].data = (uint8_t*)live + live->buffers_offset + (uint64_t)i * TRACE_BUFFER_SIZE;
+    }
+    trace_live_hooks = (trace_live_hook_t*)((uint8_t*)live + live->hooks_offset);
+    __atomic_store_n(&trace_live, live, __ATOMIC_RELEASE);
+    if (pthread_create(&trace_flush_thread, NULL, trace_flush_loop, NULL) != 0) {
+        trace_log("Could not start trace flush thread!");
+    }
+    return 0;
+}
+
+void trace_register(trace_hook_t* hook) {
+    pthread_mutex_lock(&trace_writer_lock);
+    if (trace_hook_count >= TRACE_MAX_HOOKS) {
+        pthread_mutex_unlock(&trace_writer_lock);
+        trace_log("Too many hooks registered, not tracing: %s", hook->name);
+        return;
+    }
+    hook->id = (uint16_t)trace_hook_count;
+    trace_hooks[trace_hook_count++] = hook;
+    __atomic_fetch_or(&trace_enabled[hook->id >> 5], 1u << (hook->id & 31), __ATOMIC_RELAXED);
+    if (trace_live) {
+        trace_live_hook_t* entry = &trace_live_hooks[hook->id];
+        entry->offset = (uint32_t)hook->offset;
+        snprintf(entry->name, sizeof(entry->name), "%s", hook->name);
+        __atomic_store_n(&trace_live->hook_count, (uint32_t)trace_hook_count, __ATOMIC_RELEASE);
+    }
+    if (trace_file) {
+        // Written straight to the file, ahead of any record of the hook still sitting in a thread buffer
+        char payload[1024];
+        trace_record_header_t header;
+        memset(&header, 0, sizeof(header));
+        header.hook = hook->id;
+        header.type = TRACE_RECORD_HOOKDEF;
+        header.size = trace_hookdef(hook, payload, sizeof(payload));
+        header.tid = trace_gettid();
+        header.timestamp = trace_now();
+        trace_writer_record(&header, (const uint8_t*)payload);
+    }
+    pthread_mutex_unlock(&trace_writer_lock);
+}
+
+static char trace_matches(const char* pattern, const char* name) {
+    int len = strlen(pattern);
+    if (len > 0 && pattern[len - 1] == '*') {
+        return strncmp(pattern, name, len - 1) == 0;
+    }
+    return strcmp(pattern, name) == 0;
+}
+
+static int trace_set_flag(const char* pattern, uint8_t flag) {
+    int matched = 0;
+    for (int i = 0; i < trace_hook_count; i++) {
+        if (trace_matches(pattern, trace_hooks[i]->name)) {
+            trace_hooks[i]->flags |= flag;
+            matched++;
+        }
+    }
+    return matched;
+}
+
+static int trace_set_enabled(const char* pattern, char enabled) {
+    int matched = 0;
+    for (int i = 0; i < trace_hook_count; i++) {
+        if (trace_matches(pattern, trace_hooks[i]->name)) {
+            uint16_t id = trace_hooks[i]->id;
+            if (enabled) {
+                __atomic_fetch_or(&trace_enabled[id >> 5], 1u << (id & 31), __ATOMIC_RELAXED);
+            } else {
+                __atomic_fetch_and(&trace_enabled[id >> 5], ~(1u << (id & 31)), __ATOMIC_RELAXED);
+            }
+            matched++;
+        }
+    }
+    return matched;
+}
+
+// Applies one config line, returns the type of line ("args", "frame", ...) or NULL if it was not understood
+static const char* trace_apply_line(const char* line) {
+    char pattern[256];
+    int matched;
+    const char* type;
+    if (sscanf(line, "args %255s", pattern) == 1) {
+        matched = trace_set_flag(pattern, TRACE_HOOK_CAPTURE_ARGS);
+        type = "args";
+    } else if (sscanf(line, "timed %255s", pattern) == 1) {
+        matched = trace_set_flag(pattern, TRACE_HOOK_TIMED);
+        type = "timed";
+    } else if (sscanf(line, "frame %255s", pattern) == 1) {
+        matched = trace_set_flag(pattern, TRACE_HOOK_FRAME);
+        type = "frame";
+    } else if (sscanf(line, "realtime %255s", pattern) == 1) {
+        matched = trace_set_flag(pattern, TRACE_HOOK_REALTIME | TRACE_HOOK_TIMED);
+        type = "realtime";
+    } else if (sscanf(line, "log %255s", pattern) == 1) {
+        matched = trace_set_flag(pattern, TRACE_HOOK_LOG);
+        type = "log";
+    } else if (sscanf(line, "enable %255s", pattern) == 1) {
+        matched = trace_set_enabled(pattern, '\1');
+        type = "enable";
+    } else if (sscanf(line, "disable %255s", pattern) == 1) {
+        matched = trace_set_enabled(pattern, '\0');
+        type = "disable";
+    } else {
+        return NULL;
+    }
+    trace_log("Set %s for %i hook(s) matching: %s", type, matched, pattern);
+    return type;
+}
+
+int trace_load_config(const char* path) {
+    char frame_set = '\0';
+    char realtime_set = '\0';
+    FILE* f = fopen(path, "r");
+    if (f) {
+        char line[256];
+        while (fgets(line, sizeof(line), f)) {
+            const char* type = trace_apply_line(line);
+            if (type && strcmp(type, "frame") == 0) {
+                frame_set = '\1';
+            }
+            if (type && strcmp(type, "realtime") == 0) {
+                realtime_set = '\1';
+            }
+        }
+        fclose(f);
+    }
+    if (!frame_set) {
+        trace_set_flag(TRACE_DEFAULT_FRAME_HOOK, TRACE_HOOK_FRAME);
+    }
+    if (!realtime_set) {
+        trace_set_flag(TRACE_DEFAULT_REALTIME_HOOK, TRACE_HOOK_REALTIME | TRACE_HOOK_TIMED);
+    }
+    return f ? 0 : -1;
+}
+
+// Applies the control file again whenever it changes
+static void trace_poll_control(const char* path) {
+    struct stat st;
+    if (stat(path, &st) != 0 || st.st_mtime == trace_control_mtime) {
+        return;
+    }
+    trace_control_mtime = st.st_mtime;
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        return;
+    }
+    char line[256];
+    while (fgets(line, sizeof(line), f)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        // Hook flags are read without synchronization, so only the bitmap may change while running
+        if (strncmp(line, "enable ", 7) == 0 || strncmp(line, "disable ", 8) == 0) {
+            trace_apply_line(line);
+        } else if (line[0] != '\0' && line[0] != '#') {
+            trace_log("Only enable/disable lines are applied at runtime, ignored: %s", line);
+        }
+    }
+    fclose(f);
+}
+
+// Tags the thread as real-time the first time a real-time hook runs on it, and logs the call if asked to.
+// Logging can block, so it is never done on a real-time thread.
+static void trace_hook_called(trace_buffer_t* buffer, trace_hook_t* hook, uint64_t now) {
+    trace_thread_t* thread = buffer->thread;
+    if ((hook->flags & TRACE_HOOK_REALTIME) && !(thread->flags & TRACE_THREAD_REALTIME)) {
+        __atomic_store_n(&thread->flags, thread->flags | TRACE_THREAD_REALTIME, __ATOMIC_RELAXED);
+        uint8_t flags = TRACE_THREAD_REALTIME;
+        trace_buffer_write(buffer, hook->id, TRACE_RECORD_THREAD, &flags, sizeof(flags), now);
+    }
+    if ((hook->flags & TRACE_HOOK_LOG) && !(thread->flags & TRACE_THREAD_REALTIME)) {
+        trace_log("Called %s Hook!", hook->name);
+    }
+}
+
+void trace_frame(trace_hook_t* hook) {
+    trace_buffer_t* buffer = trace_get_buffer();
+    if (!buffer) {
+        return;
+    }
+    uint32_t frame = __atomic_fetch_add(&trace_frame_count, 1, __ATOMIC_RELAXED);
+    trace_buffer_write(buffer, hook->id, TRACE_RECORD_FRAME, &frame, sizeof(frame), trace_now());
+}
+
+void trace_emit(trace_hook_t* hook, uint8_t type, const trace_args_t* args) {
+    trace_buffer_t* buffer = trace_get_buffer();
+    if (!buffer) {
+        return;
+    }
+    uint64_t now = trace_now();
+    trace_hook_called(buffer, hook, now);
+    trace_buffer_write(buffer, hook->id, type, args ? args->data : NULL, args ? args->len : 0, now);
+}
+
+void trace_enter(trace_hook_t* hook, const trace_args_t* args) {
+    trace_emit(hook, TRACE_RECORD_ENTER, args);
+}
+
+void trace_exit(trace_hook_t* hook) {
+    trace_buffer_t* buffer = trace_get_buffer();
+    if (buffer) {
+        trace_buffer_write(buffer, hook->id, TRACE_RECORD_EXIT, NULL, 0, trace_now());
+    }
+}
+
+int trace_write_stats(const char* path) {
+    FILE* f = fopen(path, "w");
+    if (!f) {
+        return -1;
+    }
+    pthread_mutex_lock(&trace_writer_lock);
+    fprintf(f, "%-70s %12s %14s %14s\n", "Method", "Calls", "Inclusive ms", "Exclusive ms");
+    for (int i = 0; i < trace_hook_count; i++) {
+        trace_hook_t* hook = trace_hooks[i];
+        if (hook->calls == 0) {
+            continue;
+        }
+        fprintf(f, "%-70s %12llu %14.3f %14.3f\n", hook->name, (unsigned long long)hook->calls, hook->inclusive / 1e6, hook->exclusive / 1e6);
+    }
+    pthread_mutex_unlock(&trace_writer_lock);
+    fclose(f);
+    return 0;
+}
+
+void trace_flush() {
+    pthread_mutex_lock(&trace_writer_lock);
+    trace_drain();
+    if (trace_file) {
+        trace_writer_block();
+        trace_writer_footer();
+    }
+    pthread_mutex_unlock(&trace_writer_lock);
+}
+
+static void trace_arg_put(trace_args_t* args, uint8_t tag, const void* data, int size) {
+    if (args->len + 1 + size > TRACE_MAX_ARGS_SIZE) {
+        return;
+    }
+    args->data[args->len++] = tag;
+    memcpy(args->data + args->len, data, size);
+    args->len += size;
+}
+
+void trace_arg_i32(trace_args_t* args, int32_t value) {
+    trace_arg_put(args, TRACE_ARG_TYPE_I32, &value, sizeof(value));
+}
+
+void trace_arg_u32(trace_args_t* args, uint32_t value) {
+    trace_arg_put(args, TRACE_ARG_TYPE_U32, &value, sizeof(value));
+}
+
+void trace_arg_f32(trace_args_t* args, float value) {
+    trace_arg_put(args, TRACE_ARG_TYPE_F32, &value, sizeof(value));
+}
+
+void trace_arg_f64(trace_args_t* args, double value) {
+    trace_arg_put(args, TRACE_ARG_TYPE_F64, &value, sizeof(value));
+}
+
+void trace_arg_bool(trace_args_t* args, uint8_t value) {
+    trace_arg_put(args, TRACE_ARG_TYPE_BOOL, &value, sizeof(value));
+}
+
+void trace_arg_value(trace_args_t* args, const void* value, int size) {
+    // Value types are stored as their raw packed layout, prefixed with a one byte length
+    if (size > 255 || args->len + 2 + size > TRACE_MAX_ARGS_SIZE) {
+        return;
+    }
+    args->data[args->len++] = TRACE_ARG_TYPE_VALUE;
+    args->data[args->len++] = (uint8_t)size;
+    memcpy(args->data + args->len, value, size);
+    args->len += size;
+}
+
+void trace_arg_string(trace_args_t* args, const uint16_t* chars, int len) {
+    if (!chars || len < 0) {
+        trace_arg_put(args, TRACE_ARG_TYPE_NULL, NULL, 0);
+        return;
+    }
+    // Only the first TRACE_MAX_STRING_CHARS code units are kept, the full length is recorded
+    int stored = len < TRACE_MAX_STRING_CHARS ? len : TRACE_MAX_STRING_CHARS;
+    if (args->len + 4 + stored * 2 > TRACE_MAX_ARGS_SIZE) {
+        return;
+    }
+    uint16_t total = len > 0xFFFF ? 0xFFFF : (uint16_t)len;
+    args->data[args->len++] = TRACE_ARG_TYPE_STRING;
+    memcpy(args->data + args->len, &total, sizeof(total));
+    args->len += sizeof(total);
+    args->data[args->len++] = (uint8_t)stored;
+    memcpy(args->data + args->len, chars, stored * 2);
+    args->len += stored * 2;
+}
@@ -0,0 +1,311 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+// Binary trace written by the temp mod.
+// All integers are little endian, all structs are packed.
+//
+// TRACE_VERSION_RAW (flight recorder dumps): a trace_file_header, followed by a stream of records.
+// Every record is a trace_record_header followed by `size` bytes of payload.
+//
+// TRACE_VERSION_COMPRESSED (streamed traces): a trace_file_header, followed by blocks.
+// Each block is a trace_block_header and `stored_size` bytes of LZ4 block data (see tracecompress.h),
+// which decompress to `raw_size` bytes of encoded records:
+//   varint type, varint hook, varint tid, zigzag varint timestamp delta, varint size, payload
+// The first delta is relative to base_timestamp, the rest to the previous record in the block.
+// After the last block comes a trace_index_entry per block and a trace_file_footer. The footer is rewritten after every block, a file cut short by a
+// crash can still be read block by block.
+
+#define TRACE_FILE "/sdcard/Android/data/com.beatgames.beatsaber/files/mods/temptrace.bin"
+#define TRACE_CONFIG_FILE "/sdcard/Android/data/com.beatgames.beatsaber/files/mods/TempTrace.cfg"
+// Flight recorder dumps, %u is the number of the slow frame
+#define TRACE_FLIGHT_FILE "/sdcard/Android/data/com.beatgames.beatsaber/files/mods/temptrace-flight-%u.bin"
+// Polled by the flush thread, takes the same "enable"/"disable" lines as TempTrace.cfg
+#define TRACE_CONTROL_FILE "/sdcard/Android/data/com.beatgames.beatsaber/files/mods/TempTraceControl.txt"
+#define TRACE_STATS_FILE "/sdcard/Android/data/com.beatgames.beatsaber/files/mods/TempTraceStats.txt"
+// Live export, used by a "live" line without a path
+#define TRACE_LIVE_FILE "/sdcard/Android/data/com.beatgames.beatsaber/files/mods/temptrace.live"
+
+#define TRACE_MAGIC "QHTRACE"
+#define TRACE_VERSION_RAW 1
+#define TRACE_VERSION_COMPRESSED 2
+#define TRACE_BLOCK_MAGIC "QHBK"
+#define TRACE_FOOTER_MAGIC "QHIX"
+
+// Maximum number of hooks that can be registered with the tracer
+#define TRACE_MAX_HOOKS 4096
+// Maximum number of payload bytes captured for the arguments of a single call
+#define TRACE_MAX_ARGS_SIZE 256
+// Strings are truncated to this many UTF-16 code units
+#define TRACE_MAX_STRING_CHARS 32
+// Hook that marks the start of a frame, unless TempTrace.cfg names another with "frame <HookName>"
+#define TRACE_DEFAULT_FRAME_HOOK "AudioTimeSyncController_Update"
+// Hook that runs on the audio thread, unless TempTrace.cfg names others with "realtime <HookName>"
+#define TRACE_DEFAULT_REALTIME_HOOK "CaptureAudioToWav_OnAudioFilterRead"
+// Depth of the shadow stack the flush thread keeps per thread for timed hooks
+#define TRACE_MAX_DEPTH 64
+// Threads that can record at the same time, each gets its own preallocated buffer
+#define TRACE_MAX_THREADS 32
+// Size of each thread's record buffer, a power of two
+#define TRACE_BUFFER_SIZE (256 * 1024)
+// How often (in milliseconds) the flush thread empties the thread buffers
+#define TRACE_DRAIN_INTERVAL_MS 20
+// Uncompressed size at which a block is closed
+#define TRACE_BLOCK_SIZE (64 * 1024)
+// Largest encoded record: 5 varints and the largest payload
+#define TRACE_MAX_RECORD_ENCODED (50 + 0xFFFF)
+// Ring size used by the flight recorder when TempTrace.cfg does not give one
+#define TRACE_FLIGHT_DEFAULT_BUFFER_KB 8192
+// How often (in milliseconds) a block is closed, the timing summary is rewritten and the control file is checked
+#define TRACE_FLUSH_INTERVAL_MS 1000
+
+typedef enum trace_record_type {
+    // Payload: uint32_t offset, then "name\0signature\0"
+    TRACE_RECORD_HOOKDEF = 1,
+    // Payload: captured arguments (may be empty)
+    TRACE_RECORD_CALL = 2,
+    // Same payload as TRACE_RECORD_CALL, marks the start of a timed call
+    TRACE_RECORD_ENTER = 3,
+    // No payload, closes the most recent TRACE_RECORD_ENTER of the same hook on the same thread
+    TRACE_RECORD_EXIT = 4,
+    // Payload: uint32_t frame number. Emitted before every call of the frame hook.
+    TRACE_RECORD_FRAME = 5,
+    // Payload: uint8_t TRACE_THREAD_* flags for the thread in tid. The hook is the one that set them.
+    TRACE_RECORD_THREAD = 6
+} trace_record_type_t;
+
+// The thread runs real-time hooks (e.g. the audio callback)
+#define TRACE_THREAD_REALTIME 0x1
+
+// Tags that prefix every captured argument in a TRACE_RECORD_CALL payload
+typedef enum trace_arg_type {
+    TRACE_ARG_TYPE_I32 = 1,    // int32_t
+    TRACE_ARG_TYPE_U32 = 2,    // uint32_t
+    TRACE_ARG_TYPE_F32 = 3,    // float
+    TRACE_ARG_TYPE_F64 = 4,    // double
+    TRACE_ARG_TYPE_BOOL = 5,   // uint8_t
+    TRACE_ARG_TYPE_VALUE = 6,  // uint8_t length, then the raw bytes of a packed struct from main.h
+    TRACE_ARG_TYPE_STRING = 7, // uint16_t total length, uint8_t stored length, then UTF-16 code units
+    TRACE_ARG_TYPE_NULL = 8    // null cs_string*
+} trace_arg_type_t;
+
+typedef struct __attribute__((__packed__)) trace_file_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+} trace_file_header_t;
+
+// Block data is stored uncompressed
+#define TRACE_BLOCK_STORED 0x1
+
+typedef struct __attribute__((__packed__)) trace_block_header {
+    char magic[4];
+    uint32_t flags;
+    uint32_t raw_size;
+    uint32_t stored_size;
+    uint32_t records;
+    uint64_t base_timestamp;
+    uint64_t min_timestamp;
+    uint64_t max_timestamp;
+} trace_block_header_t;
+
+typedef struct __attribute__((__packed__)) trace_index_entry {
+    uint64_t offset;
+    uint64_t min_timestamp;
+    uint64_t max_timestamp;
+} trace_index_entry_t;
+
+typedef struct __attribute__((__packed__)) trace_file_footer {
+    uint64_t index_offset;
+    uint32_t block_count;
+    char magic[4];
+} trace_file_footer_t;
+
+// Live export: with a "live [path]" line in TempTrace.cfg, the thread buffers are mapped from a file that other
+// processes can map read only and tail while the game runs. The game does no extra work for readers.
+// Layout, each section at the offset given in the header:
+//   trace_live_header
+//   hook_capacity trace_live_hook entries, the first hook_count are filled in (hook_count is stored after the entry)
+//   thread_count trace_thread entries
+//   thread_count buffers of buffer_size bytes, buffer i belongs to thread entry i
+// Each buffer is a ring of records (trace_record_header followed by `size` bytes of payload, HOOKDEF records
+// are not included). Positions only ever increase, a record at position p starts at offset p % buffer_size
+// and may wrap around the end. `head` is stored after the record is written. The game does not wait for
+// readers, and only writes below tail + buffer_size and at most one record past head. A reader copies a
+// record out, then checks that tail has not passed the record's position, or that head + sizeof(trace_record_header)
+// + TRACE_MAX_ARGS_SIZE is still within buffer_size of it; otherwise the copy may have been overwritten.
+// `tail` (the flush thread's cursor) is always an intact record boundary, a reader that fell behind continues there.
+#define TRACE_LIVE_MAGIC "QHLIVE"
+#define TRACE_LIVE_VERSION 1
+#define TRACE_LIVE_PAGE 4096
+#define TRACE_LIVE_NAME_SIZE 124
+
+// trace_thread states
+#define TRACE_THREAD_STATE_FREE 0
+#define TRACE_THREAD_STATE_CLAIMED 1
+#define TRACE_THREAD_STATE_USED 2
+// The thread exited, the flush thread frees the buffer once it is drained
+#define TRACE_THREAD_STATE_RELEASED 3
+
+typedef struct trace_live_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t thread_count;
+    uint32_t buffer_size;
+    uint32_t hook_capacity;
+    uint32_t hook_count;
+    uint32_t reserved;
+    uint64_t hooks_offset;
+    uint64_t threads_offset;
+    uint64_t buffers_offset;
+} trace_live_header_t;
+
+typedef struct trace_live_hook {
+    uint32_t offset;
+    char name[TRACE_LIVE_NAME_SIZE];
+} trace_live_hook_t;
+
+// Cursors of one thread buffer. head is only written by the thread that owns the buffer,
+// tail only by the flush thread, so they sit on their own cache lines.
+typedef struct trace_thread {
+    uint32_t state;
+    uint32_t tid;
+    // TRACE_THREAD_* flags
+    uint32_t flags;
+    uint32_t reserved;
+    // Records that did not fit in the buffer
+    uint64_t dropped;
+    uint64_t head __attribute__((aligned(64)));
+    uint64_t tail __attribute__((aligned(64)));
+} __attribute__((aligned(64))) trace_thread_t;
+
+typedef struct __attribute__((__packed__)) trace_record_header {
+    uint16_t hook;
+    uint8_t type;
+    uint8_t flags;
+    uint16_t size;
+    uint16_t reserved;
+    uint32_t tid;
+    uint64_t timestamp; // CLOCK_MONOTONIC nanoseconds
+} trace_record_header_t;
+
+// Per hook flags
+#define TRACE_HOOK_CAPTURE_ARGS 0x1
+// Record enter/exit pairs instead of single calls, and keep inclusive/exclusive totals
+#define TRACE_HOOK_TIMED 0x2
+// Calls to this hook mark the start of a new frame
+#define TRACE_HOOK_FRAME 0x4
+// The hook runs on a real-time thread, tag the thread in the trace
+#define TRACE_HOOK_REALTIME 0x8
+// Log every call of the hook (never done on real-time threads)
+#define TRACE_HOOK_LOG 0x10
+
+typedef struct trace_hook {
+    const char* name;
+    const char* signature;
+    long offset;
+    uint16_t id;
+    uint8_t flags;
+    // Totals for timed hooks, in nanoseconds. Kept by the flush thread.
+    uint64_t calls;
+    uint64_t inclusive;
+    uint64_t exclusive;
+} trace_hook_t;
+
+// One bit per hook id, set when the hook traces. Disabled hooks call straight through to the original.
+extern uint32_t trace_enabled[TRACE_MAX_HOOKS / 32];
+
+typedef struct trace_args {
+    uint16_t len;
+    uint8_t data[TRACE_MAX_ARGS_SIZE];
+} trace_args_t;
+
+// Opens the trace file, or sets up the flight recorder if the config has a
+// "flight <threshold_ms> <window_ms> [buffer_kb]" line. A "live [path]" line exports the thread buffers
+// for live readers (see trace_live_header). Returns 0 on success.
+int trace_init(const char* path, const char* config);
+// Assigns the hook an id and writes its definition to the trace.
+void trace_register(trace_hook_t* hook);
+// Applies the per hook settings in the given config file to all registered hooks.
+// Lines have the form "args <HookName>", "timed <HookName>", "frame <HookName>", "realtime <HookName>", "log <HookName>",
+// "enable <HookName>" or "disable <HookName>", where HookName may end with '*' to match a prefix. Every hook starts enabled.
+int trace_load_config(const char* path);
+// Emits a frame marker, called by the frame hook
+void trace_frame(trace_hook_t* hook);
+// The recording functions (trace_frame, trace_emit, trace_enter, trace_exit) are wait-free: they only write to
+// the calling thread's preallocated buffer, without locks, allocation or syscalls, so they are safe on the audio thread.
+// A full buffer drops the record. The flush thread drains the buffers and keeps the timing totals.
+void trace_emit(trace_hook_t* hook, uint8_t type, const trace_args_t* args);
+void trace_enter(trace_hook_t* hook, const trace_args_t* args);
+void trace_exit(trace_hook_t* hook);
+// Drains all thread buffers and writes them out
+void trace_flush();
+// Writes calls/inclusive/exclusive totals of all timed hooks to the given file
+int trace_write_stats(const char* path);
+
+void trace_arg_i32(trace_args_t* args, int32_t value);
+void trace_arg_u32(trace_args_t* args, uint32_t value);
+void trace_arg_f32(trace_args_t* args, float value);
+void trace_arg_f64(trace_args_t* args, double value);
+void trace_arg_bool(trace_args_t* args, uint8_t value);
+void trace_arg_value(trace_args_t* args, const void* value, int size);
+void trace_arg_string(trace_args_t* args, const uint16_t* chars, int len);
+
+// Same as MAKE_HOOK, but also defines the trace_hook_t for the hook.
+#define MAKE_TRACE_HOOK(name, addr, retval, ...) \
+trace_hook_t trace_ ## name = { #name, #__VA_ARGS__, (long) addr, 0, 0, 0, 0, 0 }; \
+MAKE_HOOK(name, addr, retval, __VA_ARGS__)
+
+// Registers before installing, so a call on another thread never sees the hook without its id
+#define INSTALL_TRACE_HOOK(name) \
+trace_register(&trace_ ## name); \
+INSTALL_HOOK(name)
+
+#define TRACE_ENABLED(name) __builtin_expect((__atomic_load_n(&trace_enabled[trace_ ## name.id >> 5], __ATOMIC_RELAXED) >> (trace_ ## name.id & 31)) & 1, 1)
+
+#define TRACE_ENTER(name) do { \
+    if (trace_ ## name.flags & TRACE_HOOK_FRAME) { \
+        trace_frame(&trace_ ## name); \
+    } \
+    if (trace_ ## name.flags & TRACE_HOOK_TIMED) { \
+        trace_enter(&trace_ ## name, NULL); \
+    } else { \
+        trace_emit(&trace_ ## name, TRACE_RECORD_CALL, NULL); \
+    } \
+} while (0)
+
+// Captures the given TRACE_ARG_* expressions into the call record when argument capture is enabled for the hook.
+#define TRACE_ENTER_ARGS(name, ...) do { \
+    trace_args_t trace_args_; \
+    trace_args_t* trace_args_ptr_ = NULL; \
+    if (trace_ ## name.flags & TRACE_HOOK_FRAME) { \
+        trace_frame(&trace_ ## name); \
+    } \
+    if (trace_ ## name.flags & TRACE_HOOK_CAPTURE_ARGS) { \
+        trace_args_.len = 0; \
+        __VA_ARGS__; \
+        trace_args_ptr_ = &trace_args_; \
+    } \
+    if (trace_ ## name.flags & TRACE_HOOK_TIMED) { \
+        trace_enter(&trace_ ## name, trace_args_ptr_); \
+    } else { \
+        trace_emit(&trace_ ## name, TRACE_RECORD_CALL, trace_args_ptr_); \
+    } \
+} while (0)
+
+#define TRACE_EXIT(name) do { \
+    if (trace_ ## name.flags & TRACE_HOOK_TIMED) { \
+        trace_exit(&trace_ ## name); \
+    } \
+} while (0)
+
+#define TRACE_ARG_I32(v) trace_arg_i32(&trace_args_, (v))
+#define TRACE_ARG_U32(v) trace_arg_u32(&trace_args_, (v))
+#define TRACE_ARG_F32(v) trace_arg_f32(&trace_args_, (v))
+#define TRACE_ARG_F64(v) trace_arg_f64(&trace_args_, (v))
+#define TRACE_ARG_BOOL(v) trace_arg_bool(&trace_args_, (v))
+#define TRACE_ARG_VALUE(v) trace_arg_value(&trace_args_, &(v), sizeof(v))
+#define TRACE_ARG_STRING(s) trace_arg_string(&trace_args_, (s) ? (const uint16_t*)(s)->str : NULL, (s) ? (s)->len : -1)
+
+#endif /* TRACE_H */
@@ -0,0 +1,163 @@
+#include <string.h>
+
+#include "tracecompress.h"
+
+// LZ4 block format: a sequence of
+//   token (literal length << 4 | match length - 4), [literal length bytes], literals,
+//   offset (uint16 little endian), [match length bytes]
+// The last sequence only has literals. Lengths of 15 continue in following bytes (255 means keep adding).
+
+#define LZ4_HASH_BITS 12
+#define LZ4_MIN_MATCH 4
+// The last match must start at least 12 bytes before the end, and the last 5 bytes are always literals
+#define LZ4_MF_LIMIT 12
+#define LZ4_LAST_LITERALS 5
+#define LZ4_MAX_OFFSET 65535
+
+static inline uint32_t lz4_read32(const uint8_t* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t lz4_hash(uint32_t v) {
+    return (v * 2654435761u) >> (32 - LZ4_HASH_BITS);
+}
+
+static uint8_t* lz4_put_length(uint8_t* op, int len) {
+    while (len >= 255) {
+        *op++ = 255;
+        len -= 255;
+    }
+    *op++ = (uint8_t)len;
+    return op;
+}
+
+static uint8_t* lz4_put_sequence(uint8_t* op, const uint8_t* literals, int literal_len, int offset, int match_len) {
+    uint8_t* token = op++;
+    *token = (uint8_t)((literal_len >= 15 ? 15 : literal_len) << 4);
+    if (literal_len >= 15) {
+        op = lz4_put_length(op, literal_len - 15);
+    }
+    memcpy(op, literals, literal_len);
+    op += literal_len;
+    if (match_len == 0) {
+        return op;
+    }
+    *op++ = (uint8_t)(offset & 0xFF);
+    *op++ = (uint8_t)(offset >> 8);
+    int ml = match_len - LZ4_MIN_MATCH;
+    *token |= (uint8_t)(ml >= 15 ? 15 : ml);
+    if (ml >= 15) {
+        op = lz4_put_length(op, ml - 15);
+    }
+    return op;
+}
+
+int trace_lz4_compress(const uint8_t* src, int size, uint8_t* dst) {
+    int table[1 << LZ4_HASH_BITS];
+    memset(table, 0xFF, sizeof(table));
+    const uint8_t* ip = src;
+    const uint8_t* anchor = src;
+    const uint8_t* end = src + size;
+    const uint8_t* limit = size > LZ4_MF_LIMIT ? end - LZ4_MF_LIMIT : src;
+    uint8_t* op = dst;
+
+    while (ip < limit) {
+        uint32_t h = lz4_hash(lz4_read32(ip));
+        int candidate = table[h];
+        table[h] = (int)(ip - src);
+        if (candidate < 0 || ip - (src + candidate) > LZ4_MAX_OFFSET || lz4_read32(src + candidate) != lz4_read32(ip)) {
+            ip++;
+            continue;
+        }
+        const uint8_t* match = src + candidate;
+        const uint8_t* mp = ip + LZ4_MIN_MATCH;
+        const uint8_t* mm = match + LZ4_MIN_MATCH;
+        while (mp < end - LZ4_LAST_LITERALS && *mp == *mm) {
+            mp++;
+            mm++;
+        }
+        op = lz4_put_sequence(op, anchor, (int)(ip - anchor), (int)(ip - match), (int)(mp - ip));
+        ip = mp;
+        anchor = ip;
+    }
+    return (int)(lz4_put_sequence(op, anchor, (int)(end - anchor), 0, 0) - dst);
+}
+
+static int lz4_get_length(const uint8_t** ip, const uint8_t* end, int len) {
+    if (len != 15) {
+        return len;
+    }
+    uint8_t b;
+    do {
+        if (*ip >= end) {
+            return -1;
+        }
+        b = *(*ip)++;
+        len += b;
+    } while (b == 255);
+    return len;
+}
+
+int trace_lz4_decompress(const uint8_t* src, int size, uint8_t* dst, int capacity) {
+    const uint8_t* ip = src;
+    const uint8_t* end = src + size;
+    uint8_t* op = dst;
+    uint8_t* op_end = dst + capacity;
+    while (ip < end) {
+        uint8_t token = *ip++;
+        int literal_len = lz4_get_length(&ip, end, token >> 4);
+        if (literal_len < 0 || literal_len > end - ip || literal_len > op_end - op) {
+            return -1;
+        }
+        memcpy(op, ip, literal_len);
+        ip += literal_len;
+        op += literal_len;
+        if (ip == end) {
+            break;
+        }
+        if (end - ip < 2) {
+            return -1;
+        }
+        int offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        int match_len = lz4_get_length(&ip, end, token & 15);
+        if (match_len < 0 || offset == 0 || offset > op - dst) {
+            return -1;
+        }
+        match_len += LZ4_MIN_MATCH;
+        if (match_len > op_end - op) {
+            return -1;
+        }
+        // Matches may overlap the output, so copy byte by byte
+        const uint8_t* match = op - offset;
+        for (int i = 0; i < match_len; i++) {
+            op[i] = match[i];
+        }
+        op += match_len;
+    }
+    return (int)(op - dst);
+}
+
+int trace_varint_put(uint8_t* dst, uint64_t value) {
+    int n = 0;
+    while (value >= 0x80) {
+        dst[n++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    dst[n++] = (uint8_t)value;
+    return n;
+}
+
+int trace_varint_get(const uint8_t* src, int size, uint64_t* value) {
+    uint64_t result = 0;
+    for (int n = 0; n < size && n < 10; n++) {
+        result |= (uint64_t)(src[n] & 0x7F) << (7 * n);
+        if ((src[n] & 0x80) == 0) {
+            *value = result;
+            return n + 1;
+        }
+    }
+    return 0;
+}
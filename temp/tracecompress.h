@@ -0,0 +1,31 @@
+#ifndef TRACECOMPRESS_H
+#define TRACECOMPRESS_H
+
+#include <stdint.h>
+
+// Encoding helpers for the compressed trace format (TRACE_VERSION_COMPRESSED).
+// Shared by the temp mod (encoder) and traceanalyzer (decoder).
+
+// Worst case size of trace_lz4_compress output for `size` input bytes
+#define TRACE_LZ4_BOUND(size) ((size) + (size) / 255 + 16)
+
+// Compresses `size` bytes from src into dst using the LZ4 block format.
+// dst must hold TRACE_LZ4_BOUND(size) bytes. Returns the compressed size.
+int trace_lz4_compress(const uint8_t* src, int size, uint8_t* dst);
+// Decompresses an LZ4 block. Returns the decompressed size, or -1 if the block is corrupt or does not fit.
+int trace_lz4_decompress(const uint8_t* src, int size, uint8_t* dst, int capacity);
+
+// Writes an unsigned LEB128 varint, returns the number of bytes written (at most 10)
+int trace_varint_put(uint8_t* dst, uint64_t value);
+// Reads an unsigned LEB128 varint, returns the number of bytes read, or 0 if it runs past `size`
+int trace_varint_get(const uint8_t* src, int size, uint64_t* value);
+
+static inline uint64_t trace_zigzag(int64_t value) {
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static inline int64_t trace_unzigzag(uint64_t value) {
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+#endif /* TRACECOMPRESS_H */
@@ -0,0 +1,120 @@
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "livereader.h"
+
+// Largest record a thread can be in the middle of writing past its published head
+#define LIVE_MAX_RECORD (sizeof(trace_record_header_t) + TRACE_MAX_ARGS_SIZE)
+
+static void live_copy_out(const uint8_t* ring, uint64_t size, uint8_t* dst, uint64_t pos, uint64_t len) {
+    uint64_t offset = pos % size;
+    uint64_t first = len < size - offset ? len : size - offset;
+    memcpy(dst, ring + offset, first);
+    memcpy(dst + first, ring, len - first);
+}
+
+// Whether the data at `pos` is still intact. The thread only writes below tail + size and at most one
+// record past its head, so the data is intact while the tail has not passed it or the head is far enough behind.
+static char live_valid(const trace_thread_t* thread, uint64_t pos, uint64_t size) {
+    uint64_t tail = __atomic_load_n(&thread->tail, __ATOMIC_RELAXED);
+    uint64_t head = __atomic_load_n(&thread->head, __ATOMIC_RELAXED);
+    return tail <= pos || head + LIVE_MAX_RECORD <= pos + size;
+}
+
+int trace_live_open(trace_live_reader_t* reader, const char* path) {
+    memset(reader, 0, sizeof(*reader));
+    reader->fd = open(path, O_RDONLY);
+    if (reader->fd < 0) {
+        return -1;
+    }
+    struct stat st;
+    if (fstat(reader->fd, &st) != 0 || (uint64_t)st.st_size < sizeof(trace_live_header_t)) {
+        close(reader->fd);
+        return -1;
+    }
+    reader->size = st.st_size;
+    void* map = mmap(NULL, reader->size, PROT_READ, MAP_SHARED, reader->fd, 0);
+    if (map == MAP_FAILED) {
+        close(reader->fd);
+        return -1;
+    }
+    reader->map = map;
+    reader->header = map;
+    const trace_live_header_t* header = reader->header;
+    if (memcmp(header->magic, TRACE_LIVE_MAGIC, sizeof(TRACE_LIVE_MAGIC)) != 0 || header->version != TRACE_LIVE_VERSION ||
+        header->thread_count > TRACE_MAX_THREADS || header->hook_capacity > TRACE_MAX_HOOKS ||
+        header->buffers_offset + (uint64_t)header->thread_count * header->buffer_size > reader->size) {
+        trace_live_close(reader);
+        return -1;
+    }
+    reader->hooks = (const trace_live_hook_t*)(reader->map + header->hooks_offset);
+    reader->threads = (const trace_thread_t*)(reader->map + header->threads_offset);
+    reader->buffers = reader->map + header->buffers_offset;
+    for (uint32_t i = 0; i < header->thread_count; i++) {
+        reader->cursors[i] = __atomic_load_n(&reader->threads[i].head, __ATOMIC_ACQUIRE);
+    }
+    return 0;
+}
+
+uint64_t trace_live_poll(trace_live_reader_t* reader, trace_live_callback_t callback, void* context) {
+    const trace_live_header_t* header = reader->header;
+    uint64_t size = header->buffer_size;
+    uint64_t records = 0;
+    uint8_t record[LIVE_MAX_RECORD];
+    for (uint32_t i = 0; i < header->thread_count; i++) {
+        const uint8_t* ring = reader->buffers + (uint64_t)i * size;
+        uint64_t head = __atomic_load_n(&reader->threads[i].head, __ATOMIC_ACQUIRE);
+        uint64_t pos = reader->cursors[i];
+        if (head < pos || !live_valid(&reader->threads[i], pos, size)) {
+            // Fell too far behind (or the game restarted). The flush thread's tail is a record boundary
+            // the thread cannot overwrite yet.
+            reader->lost++;
+            pos = __atomic_load_n(&reader->threads[i].tail, __ATOMIC_ACQUIRE);
+        }
+        while (pos < head) {
+            trace_record_header_t* record_header = (trace_record_header_t*)record;
+            live_copy_out(ring, size, record, pos, sizeof(*record_header));
+            uint64_t len = sizeof(*record_header) + record_header->size;
+            if (record_header->size > TRACE_MAX_ARGS_SIZE || pos + len > head) {
+                reader->lost++;
+                pos = __atomic_load_n(&reader->threads[i].tail, __ATOMIC_ACQUIRE);
+                break;
+            }
+            live_copy_out(ring, size, record + sizeof(*record_header), pos + sizeof(*record_header), record_header->size);
+            // The copy is only good if the thread has not come around to this position since
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            if (!live_valid(&reader->threads[i], pos, size)) {
+                reader->lost++;
+                pos = __atomic_load_n(&reader->threads[i].tail, __ATOMIC_ACQUIRE);
+                break;
+            }
+            callback(context, record_header, record + sizeof(*record_header));
+            records++;
+            pos += len;
+        }
+        reader->cursors[i] = pos;
+    }
+    return records;
+}
+
+const char* trace_live_hook_name(const trace_live_reader_t* reader, uint16_t hook) {
+    if (hook >= __atomic_load_n(&reader->header->hook_count, __ATOMIC_ACQUIRE)) {
+        return NULL;
+    }
+    return reader->hooks[hook].name;
+}
+
+void trace_live_close(trace_live_reader_t* reader) {
+    if (reader->map) {
+        munmap(reader->map, reader->size);
+        reader->map = NULL;
+    }
+    if (reader->fd >= 0) {
+        close(reader->fd);
+        reader->fd = -1;
+    }
+}
@@ -0,0 +1,35 @@
+#ifndef LIVEREADER_H
+#define LIVEREADER_H
+
+#include <stdint.h>
+#include "../temp/trace.h"
+
+// Tails the live export of the temp mod (a "live" line in TempTrace.cfg, layout in trace.h).
+// The file is mapped read only and each thread buffer is followed with its own cursor,
+// so reading never slows down or blocks the game.
+
+typedef struct trace_live_reader {
+    int fd;
+    uint8_t* map;
+    uint64_t size;
+    const trace_live_header_t* header;
+    const trace_live_hook_t* hooks;
+    const trace_thread_t* threads;
+    const uint8_t* buffers;
+    uint64_t cursors[TRACE_MAX_THREADS];
+    // Records overwritten by the game before they were read
+    uint64_t lost;
+} trace_live_reader_t;
+
+typedef void (*trace_live_callback_t)(void* context, const trace_record_header_t* header, const uint8_t* payload);
+
+// Maps the export and starts at the current end of every buffer. Returns 0 on success.
+int trace_live_open(trace_live_reader_t* reader, const char* path);
+// Calls `callback` for every record written since the last poll, returns the number of records.
+// Records of one thread come in order, records of different threads are not merged.
+uint64_t trace_live_poll(trace_live_reader_t* reader, trace_live_callback_t callback, void* context);
+// Name of a registered hook, or NULL
+const char* trace_live_hook_name(const trace_live_reader_t* reader, uint16_t hook);
+void trace_live_close(trace_live_reader_t* reader);
+
+#endif /* LIVEREADER_H */
@@ -0,0 +1,721 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "tracereader.h"
+
+// Host side analyzer for traces written by the temp mod.
+// Reconstructs per thread call trees from enter/exit records and writes:
+//  - a chrome://tracing JSON file (-c)
+//  - collapsed stacks for flamegraph.pl (-f)
+//  - per method inclusive/exclusive time tables (stdout)
+//  - frames over the frame time budget, with the methods that used most of them (stdout)
+//  - for real-time threads, how much of the callback budget each method uses (stdout)
+
+#define MAX_THREADS 256
+#define MAX_DEPTH 256
+
+typedef struct method {
+    char* name;
+    uint32_t offset;
+    uint64_t calls;
+    uint64_t inclusive;
+    uint64_t exclusive;
+} method_t;
+
+// Node of the calling context tree, one per unique call path
+typedef struct node {
+    int parent;
+    uint16_t hook;
+    uint64_t calls;
+    uint64_t self;
+} node_t;
+
+typedef struct frame {
+    int node;
+    uint16_t hook;
+    uint64_t start;
+    uint64_t children;
+} frame_t;
+
+typedef struct thread {
+    uint32_t tid;
+    int depth;
+    // Frames beyond MAX_DEPTH are not tracked, but still counted so exits stay balanced
+    int overflow;
+    frame_t stack[MAX_DEPTH];
+    // Number of active frames per hook, so recursive calls are only counted once in inclusive time
+    uint16_t active[TRACE_MAX_HOOKS];
+    // Set for threads tagged by a TRACE_RECORD_THREAD record
+    struct realtime* realtime;
+} thread_t;
+
+// Real-time thread (e.g. the audio thread): each outermost timed call is one callback,
+// and the time between callbacks is the budget the methods run in.
+typedef struct realtime {
+    uint16_t hook;
+    uint64_t callbacks;
+    uint64_t first_start;
+    uint64_t last_start;
+    uint64_t total;
+    uint64_t max;
+    // Self time per method in the current callback, and totals and maximum over all callbacks
+    uint64_t self[TRACE_MAX_HOOKS];
+    uint64_t self_total[TRACE_MAX_HOOKS];
+    uint64_t self_max[TRACE_MAX_HOOKS];
+    uint16_t touched[TRACE_MAX_HOOKS];
+    int touched_count;
+} realtime_t;
+
+static method_t methods[TRACE_MAX_HOOKS];
+static thread_t* threads[MAX_THREADS];
+static int thread_count = 0;
+
+static node_t* nodes = NULL;
+static int node_count = 0;
+static int node_capacity = 0;
+// Open addressing map from (parent, hook) to node index
+static int* node_table = NULL;
+static uint64_t node_table_size = 0;
+
+// Time spent in traced methods during the current frame.
+// Calls are attributed to the frame in which they exit.
+typedef struct frame_stats {
+    char started;
+    uint32_t number;
+    uint64_t start;
+    uint64_t traced;
+    uint64_t self[TRACE_MAX_HOOKS];
+    uint16_t touched[TRACE_MAX_HOOKS];
+    int touched_count;
+} frame_stats_t;
+
+static frame_stats_t frame;
+static uint64_t frame_budget = 11100000; // 11.1ms, 90Hz
+static int frame_top = 5;
+static uint64_t frames_total = 0;
+static uint64_t frames_over = 0;
+static uint64_t frame_worst = 0;
+static uint32_t frame_worst_number = 0;
+// Every frame's duration, for the mean and percentiles that before/after comparisons use
+static uint64_t* frame_durations = NULL;
+static uint64_t frame_durations_capacity = 0;
+
+static FILE* chrome = NULL;
+static char chrome_first = '\1';
+
+static uint64_t first_timestamp = 0;
+static uint64_t last_timestamp = 0;
+
+static uint64_t node_hash(int parent, uint16_t hook) {
+    uint64_t h = ((uint64_t)(uint32_t)parent << 16) | hook;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    return h;
+}
+
+static void node_table_insert(int index) {
+    uint64_t mask = node_table_size - 1;
+    uint64_t slot = node_hash(nodes[index].parent, nodes[index].hook) & mask;
+    while (node_table[slot] >= 0) {
+        slot = (slot + 1) & mask;
+    }
+    node_table[slot] = index;
+}
+
+static int node_child(int parent, uint16_t hook) {
+    if (node_table_size > 0) {
+        uint64_t mask = node_table_size - 1;
+        uint64_t slot = node_hash(parent, hook) & mask;
+        while (node_table[slot] >= 0) {
+            node_t* n = &nodes[node_table[slot]];
+            if (n->parent == parent && n->hook == hook) {
+                return node_table[slot];
+            }
+            slot = (slot + 1) & mask;
+        }
+    }
+    if (node_count == node_capacity) {
+        node_capacity = node_capacity ? node_capacity * 2 : 1024;
+        nodes = realloc(nodes, node_capacity * sizeof(node_t));
+    }
+    int index = node_count++;
+    nodes[index].parent = parent;
+    nodes[index].hook = hook;
+    nodes[index].calls = 0;
+    nodes[index].self = 0;
+    if ((uint64_t)node_count * 2 > node_table_size) {
+        free(node_table);
+        node_table_size = node_table_size ? node_table_size * 2 : 4096;
+        node_table = malloc(node_table_size * sizeof(int));
+        memset(node_table, 0xFF, node_table_size * sizeof(int));
+        for (int i = 0; i < node_count; i++) {
+            node_table_insert(i);
+        }
+    } else {
+        node_table_insert(index);
+    }
+    return index;
+}
+
+static thread_t* get_thread(uint32_t tid) {
+    for (int i = 0; i < thread_count; i++) {
+        if (threads[i]->tid == tid) {
+            return threads[i];
+        }
+    }
+    if (thread_count == MAX_THREADS) {
+        return NULL;
+    }
+    thread_t* t = calloc(1, sizeof(thread_t));
+    t->tid = tid;
+    threads[thread_count++] = t;
+    return t;
+}
+
+static const char* method_name(uint16_t hook) {
+    static char unknown[32];
+    if (methods[hook].name) {
+        return methods[hook].name;
+    }
+    snprintf(unknown, sizeof(unknown), "hook_%u", hook);
+    return unknown;
+}
+
+static void json_string_utf16(FILE* out, const uint16_t* chars, int len) {
+    fputc('"', out);
+    for (int i = 0; i < len; i++) {
+        uint16_t c = chars[i];
+        if (c == '"' || c == '\\') {
+            fprintf(out, "\\%c", c);
+        } else if (c < 0x20 || c > 0x7E) {
+            fprintf(out, "\\u%04x", c);
+        } else {
+            fputc(c, out);
+        }
+    }
+    fputc('"', out);
+}
+
+// Writes captured arguments as the members of a JSON object
+static void json_args(FILE* out, const uint8_t* data, uint16_t size) {
+    uint16_t pos = 0;
+    int index = 0;
+    while (pos < size) {
+        uint8_t tag = data[pos++];
+        if (index > 0) {
+            fputc(',', out);
+        }
+        fprintf(out, "\"a%i\":", index++);
+        if (tag == TRACE_ARG_TYPE_I32 && pos + 4 <= size) {
+            int32_t v; memcpy(&v, data + pos, 4); pos += 4;
+            fprintf(out, "%i", v);
+        } else if (tag == TRACE_ARG_TYPE_U32 && pos + 4 <= size) {
+            uint32_t v; memcpy(&v, data + pos, 4); pos += 4;
+            fprintf(out, "%u", v);
+        } else if (tag == TRACE_ARG_TYPE_F32 && pos + 4 <= size) {
+            float v; memcpy(&v, data + pos, 4); pos += 4;
+            fprintf(out, "%g", v);
+        } else if (tag == TRACE_ARG_TYPE_F64 && pos + 8 <= size) {
+            double v; memcpy(&v, data + pos, 8); pos += 8;
+            fprintf(out, "%g", v);
+        } else if (tag == TRACE_ARG_TYPE_BOOL && pos + 1 <= size) {
+            fprintf(out, "%s", data[pos++] ? "true" : "false");
+        } else if (tag == TRACE_ARG_TYPE_VALUE && pos + 1 <= size && pos + 1 + data[pos] <= size) {
+            uint8_t len = data[pos++];
+            fputc('"', out);
+            for (int i = 0; i < len; i++) {
+                fprintf(out, "%02x", data[pos + i]);
+            }
+            fputc('"', out);
+            pos += len;
+        } else if (tag == TRACE_ARG_TYPE_STRING && pos + 3 <= size && pos + 3 + data[pos + 2] * 2 <= size) {
+            uint8_t stored = data[pos + 2];
+            uint16_t chars[256];
+            memcpy(chars, data + pos + 3, stored * 2);
+            json_string_utf16(out, chars, stored);
+            pos += 3 + stored * 2;
+        } else if (tag == TRACE_ARG_TYPE_NULL) {
+            fprintf(out, "null");
+        } else {
+            // Unknown or corrupt argument, stop decoding this record
+            fprintf(out, "null");
+            break;
+        }
+    }
+}
+
+static void chrome_event(const char* phase, uint16_t hook, uint32_t tid, uint64_t timestamp, const uint8_t* args, uint16_t size) {
+    if (!chrome) {
+        return;
+    }
+    fprintf(chrome, "%s\n{\"name\":\"%s\",\"ph\":\"%s\",\"pid\":1,\"tid\":%u,\"ts\":%.3f", chrome_first ? "" : ",", method_name(hook), phase, tid, (timestamp - first_timestamp) / 1000.0);
+    if (phase[0] == 'i') {
+        fprintf(chrome, ",\"s\":\"t\"");
+    }
+    if (size > 0) {
+        fprintf(chrome, ",\"args\":{");
+        json_args(chrome, args, size);
+        fputc('}', chrome);
+    }
+    fputc('}', chrome);
+    chrome_first = '\0';
+}
+
+static void frame_attribute(uint16_t hook, uint64_t self) {
+    if (!frame.started) {
+        return;
+    }
+    if (frame.self[hook] == 0) {
+        frame.touched[frame.touched_count++] = hook;
+    }
+    // Keep touched entries unique even for zero length calls
+    frame.self[hook] += self ? self : 1;
+    frame.traced += self;
+}
+
+static int compare_frame_self(const void* a, const void* b) {
+    uint64_t x = frame.self[*(const uint16_t*)a];
+    uint64_t y = frame.self[*(const uint16_t*)b];
+    return x < y ? 1 : (x > y ? -1 : 0);
+}
+
+// Closes the current frame at the given timestamp and reports it if it went over budget
+static void frame_end(uint64_t timestamp) {
+    if (!frame.started) {
+        return;
+    }
+    uint64_t duration = timestamp - frame.start;
+    if (frames_total == frame_durations_capacity) {
+        uint64_t capacity = frame_durations_capacity ? frame_durations_capacity * 2 : 4096;
+        uint64_t* durations = realloc(frame_durations, capacity * sizeof(uint64_t));
+        if (durations) {
+            frame_durations = durations;
+            frame_durations_capacity = capacity;
+        }
+    }
+    if (frames_total < frame_durations_capacity) {
+        frame_durations[frames_total] = duration;
+    }
+    frames_total++;
+    if (duration > frame_worst) {
+        frame_worst = duration;
+        frame_worst_number = frame.number;
+    }
+    if (duration > frame_budget) {
+        if (frames_over == 0) {
+            printf("Frames over %.1f ms budget:\n", frame_budget / 1e6);
+        }
+        frames_over++;
+        printf("  frame %u at %.3f ms: %.3f ms, %.3f ms traced\n", frame.number, (frame.start - first_timestamp) / 1e6, duration / 1e6, frame.traced / 1e6);
+        qsort(frame.touched, frame.touched_count, sizeof(uint16_t), compare_frame_self);
+        for (int i = 0; i < frame.touched_count && i < frame_top; i++) {
+            printf("    %-70s %10.3f ms\n", method_name(frame.touched[i]), frame.self[frame.touched[i]] / 1e6);
+        }
+    }
+    for (int i = 0; i < frame.touched_count; i++) {
+        frame.self[frame.touched[i]] = 0;
+    }
+    frame.touched_count = 0;
+    frame.traced = 0;
+    frame.started = '\0';
+}
+
+static int compare_u64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+// Mean, median and 99th percentile frame time
+static void print_frame_times() {
+    uint64_t count = frames_total < frame_durations_capacity ? frames_total : frame_durations_capacity;
+    if (count == 0) {
+        return;
+    }
+    qsort(frame_durations, count, sizeof(uint64_t), compare_u64);
+    uint64_t sum = 0;
+    for (uint64_t i = 0; i < count; i++) {
+        sum += frame_durations[i];
+    }
+    printf("frame time: mean %.3f ms, p50 %.3f ms, p99 %.3f ms\n", sum / (double)count / 1e6, frame_durations[count / 2] / 1e6, frame_durations[count * 99 / 100] / 1e6);
+}
+
+static void frame_begin(uint32_t number, uint64_t timestamp) {
+    frame_end(timestamp);
+    frame.started = '\1';
+    frame.number = number;
+    frame.start = timestamp;
+}
+
+static void chrome_thread_name(uint32_t tid, const char* name) {
+    if (!chrome) {
+        return;
+    }
+    fprintf(chrome, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s %u\"}}", chrome_first ? "" : ",", tid, name, tid);
+    chrome_first = '\0';
+}
+
+static void realtime_attribute(realtime_t* rt, uint16_t hook, uint64_t self) {
+    if (rt->self[hook] == 0) {
+        rt->touched[rt->touched_count++] = hook;
+    }
+    // Keep touched entries unique even for zero length calls
+    rt->self[hook] += self ? self : 1;
+}
+
+// Closes a callback of a real-time thread that started at `start` and took `duration`
+static void realtime_callback(realtime_t* rt, uint64_t start, uint64_t duration) {
+    if (rt->callbacks == 0) {
+        rt->first_start = start;
+    }
+    rt->callbacks++;
+    rt->last_start = start;
+    rt->total += duration;
+    if (duration > rt->max) {
+        rt->max = duration;
+    }
+    for (int i = 0; i < rt->touched_count; i++) {
+        uint16_t hook = rt->touched[i];
+        rt->self_total[hook] += rt->self[hook];
+        if (rt->self[hook] > rt->self_max[hook]) {
+            rt->self_max[hook] = rt->self[hook];
+        }
+        rt->self[hook] = 0;
+    }
+    rt->touched_count = 0;
+}
+
+static void chrome_frame(uint32_t number, uint64_t timestamp) {
+    if (!chrome) {
+        return;
+    }
+    fprintf(chrome, "%s\n{\"name\":\"Frame %u\",\"ph\":\"i\",\"s\":\"g\",\"pid\":1,\"tid\":0,\"ts\":%.3f}", chrome_first ? "" : ",", number, (timestamp - first_timestamp) / 1000.0);
+    chrome_first = '\0';
+}
+
+static void enter(thread_t* t, uint16_t hook, uint64_t timestamp) {
+    if (t->depth >= MAX_DEPTH) {
+        t->overflow++;
+        return;
+    }
+    int parent = t->depth > 0 ? t->stack[t->depth - 1].node : -1;
+    frame_t* f = &t->stack[t->depth++];
+    f->node = node_child(parent, hook);
+    f->hook = hook;
+    f->start = timestamp;
+    f->children = 0;
+    t->active[hook]++;
+}
+
+static void pop(thread_t* t, uint64_t timestamp) {
+    frame_t* f = &t->stack[--t->depth];
+    uint64_t duration = timestamp > f->start ? timestamp - f->start : 0;
+    uint64_t self = duration > f->children ? duration - f->children : 0;
+    method_t* m = &methods[f->hook];
+    t->active[f->hook]--;
+    m->calls++;
+    m->exclusive += self;
+    if (t->active[f->hook] == 0) {
+        m->inclusive += duration;
+    }
+    nodes[f->node].calls++;
+    nodes[f->node].self += self;
+    frame_attribute(f->hook, self);
+    if (t->realtime) {
+        realtime_attribute(t->realtime, f->hook, self);
+        if (t->depth == 0) {
+            realtime_callback(t->realtime, f->start, duration);
+        }
+    }
+    if (t->depth > 0) {
+        t->stack[t->depth - 1].children += duration;
+    }
+}
+
+static void exit_hook(thread_t* t, uint16_t hook, uint64_t timestamp) {
+    if (t->overflow > 0) {
+        t->overflow--;
+        return;
+    }
+    // Find the matching frame, any frames above it lost their exits and are closed here
+    int match = t->depth - 1;
+    while (match >= 0 && t->stack[match].hook != hook) {
+        match--;
+    }
+    if (match < 0) {
+        // Exit without an enter, the call started before the trace did
+        return;
+    }
+    while (t->depth > match) {
+        if (chrome && t->depth - 1 > match) {
+            chrome_event("E", t->stack[t->depth - 1].hook, t->tid, timestamp, NULL, 0);
+        }
+        pop(t, timestamp);
+    }
+}
+
+static void write_folded(FILE* out) {
+    char* path = malloc(MAX_DEPTH * 256);
+    int chain[MAX_DEPTH];
+    for (int i = 0; i < node_count; i++) {
+        if (nodes[i].self == 0) {
+            continue;
+        }
+        int depth = 0;
+        for (int n = i; n >= 0 && depth < MAX_DEPTH; n = nodes[n].parent) {
+            chain[depth++] = n;
+        }
+        int len = 0;
+        for (int d = depth - 1; d >= 0; d--) {
+            len += snprintf(path + len, MAX_DEPTH * 256 - len, "%s%s", d == depth - 1 ? "" : ";", method_name(nodes[chain[d]].hook));
+        }
+        // Collapsed stack values are in microseconds
+        fprintf(out, "%s %llu\n", path, (unsigned long long)(nodes[i].self / 1000));
+    }
+    free(path);
+}
+
+static int compare_exclusive(const void* a, const void* b) {
+    const method_t* x = &methods[*(const uint16_t*)a];
+    const method_t* y = &methods[*(const uint16_t*)b];
+    if (x->exclusive != y->exclusive) {
+        return x->exclusive < y->exclusive ? 1 : -1;
+    }
+    return x->calls < y->calls ? 1 : (x->calls > y->calls ? -1 : 0);
+}
+
+static void print_table(int top) {
+    static uint16_t order[TRACE_MAX_HOOKS];
+    int count = 0;
+    for (int i = 0; i < TRACE_MAX_HOOKS; i++) {
+        if (methods[i].calls > 0) {
+            order[count++] = i;
+        }
+    }
+    qsort(order, count, sizeof(uint16_t), compare_exclusive);
+    printf("%-70s %12s %14s %14s %12s\n", "Method", "Calls", "Inclusive ms", "Exclusive ms", "Avg excl us");
+    for (int i = 0; i < count && i < top; i++) {
+        method_t* m = &methods[order[i]];
+        printf("%-70s %12llu %14.3f %14.3f %12.3f\n", method_name(order[i]), (unsigned long long)m->calls,
+            m->inclusive / 1e6, m->exclusive / 1e6, m->exclusive / 1e3 / m->calls);
+    }
+}
+
+static realtime_t* sort_realtime;
+
+static int compare_realtime_total(const void* a, const void* b) {
+    uint64_t x = sort_realtime->self_total[*(const uint16_t*)a];
+    uint64_t y = sort_realtime->self_total[*(const uint16_t*)b];
+    return x < y ? 1 : (x > y ? -1 : 0);
+}
+
+// Prints the share of the callback period each method uses on every real-time thread.
+// The period is the average time between callback starts.
+static void print_realtime(int top) {
+    static uint16_t order[TRACE_MAX_HOOKS];
+    for (int i = 0; i < thread_count; i++) {
+        realtime_t* rt = threads[i]->realtime;
+        if (!rt || rt->callbacks == 0) {
+            continue;
+        }
+        double period = rt->callbacks > 1 ? (double)(rt->last_start - rt->first_start) / (rt->callbacks - 1) : 0;
+        printf("\nReal-time thread %u (%s): %llu callbacks", threads[i]->tid, method_name(rt->hook), (unsigned long long)rt->callbacks);
+        if (period <= 0) {
+            printf(", avg %.3f ms, max %.3f ms\n", rt->total / 1e6 / rt->callbacks, rt->max / 1e6);
+            continue;
+        }
+        printf(" every %.3f ms, avg %.3f ms (%.1f%%), max %.3f ms (%.1f%%)\n", period / 1e6, rt->total / 1e6 / rt->callbacks,
+            100.0 * rt->total / rt->callbacks / period, rt->max / 1e6, 100.0 * rt->max / period);
+        int count = 0;
+        for (int h = 0; h < TRACE_MAX_HOOKS; h++) {
+            if (rt->self_total[h] > 0) {
+                order[count++] = h;
+            }
+        }
+        sort_realtime = rt;
+        qsort(order, count, sizeof(uint16_t), compare_realtime_total);
+        printf("  %-68s %12s %12s %10s %10s\n", "Method", "Avg us", "Max us", "Avg %", "Max %");
+        for (int n = 0; n < count && n < top; n++) {
+            uint16_t h = order[n];
+            double avg = (double)rt->self_total[h] / rt->callbacks;
+            printf("  %-68s %12.3f %12.3f %10.2f %10.2f\n", method_name(h), avg / 1e3, rt->self_max[h] / 1e3,
+                100.0 * avg / period, 100.0 * rt->self_max[h] / period);
+        }
+    }
+}
+
+static void usage(const char* name) {
+    fprintf(stderr, "Usage: %s [-c chrome.json] [-f folded.txt] [-n top] [-b budget_ms] [-k top_per_frame] [-s start_ms] [-e end_ms] trace.bin\n", name);
+}
+
+int main(int argc, char** argv) {
+    const char* chrome_path = NULL;
+    const char* folded_path = NULL;
+    int top = 50;
+    // Time range to analyze, in milliseconds from the first record of the trace
+    double range_start = -1;
+    double range_end = -1;
+    int opt;
+    while ((opt = getopt(argc, argv, "c:f:n:b:k:s:e:h")) != -1) {
+        switch (opt) {
+        case 'c':
+            chrome_path = optarg;
+            break;
+        case 'f':
+            folded_path = optarg;
+            break;
+        case 'n':
+            top = atoi(optarg);
+            break;
+        case 'b':
+            frame_budget = (uint64_t)(atof(optarg) * 1e6);
+            break;
+        case 'k':
+            frame_top = atoi(optarg);
+            break;
+        case 's':
+            range_start = atof(optarg);
+            break;
+        case 'e':
+            range_end = atof(optarg);
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (optind >= argc) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    trace_reader_t reader;
+    if (trace_reader_open(&reader, argv[optind]) != 0) {
+        fprintf(stderr, "Could not open trace: %s\n", argv[optind]);
+        return 1;
+    }
+    if (chrome_path) {
+        chrome = fopen(chrome_path, "w");
+        if (!chrome) {
+            fprintf(stderr, "Could not open output: %s\n", chrome_path);
+            return 1;
+        }
+        fprintf(chrome, "{\"traceEvents\":[");
+    }
+
+    trace_record_header_t header;
+    const uint8_t* payload;
+    trace_reader_status_t status;
+    uint64_t records = 0;
+    uint64_t origin = 0;
+    uint64_t start = 0;
+    uint64_t end = UINT64_MAX;
+    while ((status = trace_reader_next(&reader, &header, &payload)) == TRACE_READER_RECORD) {
+        records++;
+        if (header.hook >= TRACE_MAX_HOOKS) {
+            continue;
+        }
+        if (header.type == TRACE_RECORD_HOOKDEF) {
+            if (header.size > sizeof(uint32_t)) {
+                memcpy(&methods[header.hook].offset, payload, sizeof(uint32_t));
+                free(methods[header.hook].name);
+                methods[header.hook].name = strndup((const char*)payload + sizeof(uint32_t), header.size - sizeof(uint32_t));
+            }
+            continue;
+        }
+        if (origin == 0) {
+            // Hook definitions are all at the start of the trace, so they are read before seeking
+            origin = header.timestamp;
+            if (range_start > 0) {
+                start = origin + (uint64_t)(range_start * 1e6);
+                trace_reader_seek(&reader, start);
+            }
+            if (range_end >= 0) {
+                end = origin + (uint64_t)(range_end * 1e6);
+            }
+        }
+        if (header.timestamp < start) {
+            continue;
+        }
+        if (header.timestamp > end) {
+            break;
+        }
+        if (first_timestamp == 0) {
+            first_timestamp = header.timestamp;
+        }
+        if (header.timestamp > last_timestamp) {
+            last_timestamp = header.timestamp;
+        }
+        thread_t* t = get_thread(header.tid);
+        if (!t) {
+            continue;
+        }
+        switch (header.type) {
+        case TRACE_RECORD_CALL:
+            methods[header.hook].calls++;
+            chrome_event("i", header.hook, header.tid, header.timestamp, payload, header.size);
+            break;
+        case TRACE_RECORD_ENTER:
+            enter(t, header.hook, header.timestamp);
+            chrome_event("B", header.hook, header.tid, header.timestamp, payload, header.size);
+            break;
+        case TRACE_RECORD_EXIT:
+            exit_hook(t, header.hook, header.timestamp);
+            chrome_event("E", header.hook, header.tid, header.timestamp, NULL, 0);
+            break;
+        case TRACE_RECORD_THREAD:
+            if (header.size >= 1 && (payload[0] & TRACE_THREAD_REALTIME) && !t->realtime) {
+                t->realtime = calloc(1, sizeof(realtime_t));
+                t->realtime->hook = header.hook;
+                chrome_thread_name(header.tid, "realtime");
+            }
+            break;
+        case TRACE_RECORD_FRAME:
+            if (header.size >= sizeof(uint32_t)) {
+                uint32_t number;
+                memcpy(&number, payload, sizeof(number));
+                frame_begin(number, header.timestamp);
+                chrome_frame(number, header.timestamp);
+            }
+            break;
+        }
+    }
+    if (status == TRACE_READER_TRUNCATED) {
+        fprintf(stderr, "Trace is truncated after %llu records, closing open calls at the last timestamp\n", (unsigned long long)records);
+    }
+    // Calls still open at the end of the trace (crash or trace stopped mid call) end at the last timestamp
+    for (int i = 0; i < thread_count; i++) {
+        while (threads[i]->depth > 0) {
+            chrome_event("E", threads[i]->stack[threads[i]->depth - 1].hook, threads[i]->tid, last_timestamp, NULL, 0);
+            pop(threads[i], last_timestamp);
+        }
+    }
+    frame_end(last_timestamp);
+    trace_reader_close(&reader);
+
+    if (chrome) {
+        fprintf(chrome, "\n]}\n");
+        fclose(chrome);
+    }
+    if (folded_path) {
+        FILE* folded = fopen(folded_path, "w");
+        if (!folded) {
+            fprintf(stderr, "Could not open output: %s\n", folded_path);
+            return 1;
+        }
+        write_folded(folded);
+        fclose(folded);
+    }
+    printf("%llu records, %i threads, %.3f ms\n", (unsigned long long)records, thread_count, (last_timestamp - first_timestamp) / 1e6);
+    if (frames_total > 0) {
+        printf("%llu frames, %llu over %.1f ms budget, worst frame %u: %.3f ms\n", (unsigned long long)frames_total, (unsigned long long)frames_over,
+            frame_budget / 1e6, frame_worst_number, frame_worst / 1e6);
+        print_frame_times();
+    }
+    print_table(top);
+    print_realtime(top);
+    return 0;
+}
@@ -0,0 +1,252 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "../temp/trace.h"
+
+// Host microbenchmark of the cost temp adds to every hooked call, one layer at a time:
+//   direct     the game calling the original method through a pointer
+//   trampoline a MAKE_HOOK style hook that only calls the original
+//   disabled   the TRACE_ENABLED check of a hook whose bit is clear
+//   record     an enabled hook writing one call record
+//   timed      an enabled timed hook writing an enter/exit pair
+//   sampled    a hook recording one call in TRACE_BENCH_SAMPLE_RATE
+// Every layer runs on 1, 2, 4, ... threads at once, so contention in the trace sink shows up as a
+// rising ns/event. Events run in rounds that fit in a thread buffer, and the buffers are drained between
+// rounds outside of the timed region, so the numbers are never those of the drop path.
+
+// Calls per round and thread, small enough that a round of timed pairs fits in a thread buffer
+#define TRACE_BENCH_ROUND 4096
+#define TRACE_BENCH_SAMPLE_RATE 64
+
+typedef int (*bench_fn_t)(int);
+
+trace_hook_t trace_bench_disabled = { "Bench_Disabled", "int x", 0, 0, 0, 0, 0, 0 };
+trace_hook_t trace_bench_record = { "Bench_Record", "int x", 0, 0, 0, 0, 0, 0 };
+trace_hook_t trace_bench_timed = { "Bench_Timed", "int x", 0, 0, TRACE_HOOK_TIMED, 0, 0, 0 };
+trace_hook_t trace_bench_sampled = { "Bench_Sampled", "int x", 0, 0, 0, 0, 0, 0 };
+
+__attribute__((noinline)) static int bench_original(int x) {
+    __asm__ volatile("" : "+r"(x));
+    return x + 1;
+}
+
+// What INSTALL_HOOK fills in with the trampoline to the original
+static bench_fn_t volatile bench_original_ptr = bench_original;
+
+__attribute__((noinline)) static int bench_trampoline(int x) {
+    return bench_original_ptr(x);
+}
+
+__attribute__((noinline)) static int bench_disabled(int x) {
+    if (!TRACE_ENABLED(bench_disabled)) {
+        return bench_original_ptr(x);
+    }
+    TRACE_ENTER(bench_disabled);
+    int ret = bench_original_ptr(x);
+    TRACE_EXIT(bench_disabled);
+    return ret;
+}
+
+__attribute__((noinline)) static int bench_record(int x) {
+    if (!TRACE_ENABLED(bench_record)) {
+        return bench_original_ptr(x);
+    }
+    TRACE_ENTER(bench_record);
+    int ret = bench_original_ptr(x);
+    TRACE_EXIT(bench_record);
+    return ret;
+}
+
+__attribute__((noinline)) static int bench_timed(int x) {
+    if (!TRACE_ENABLED(bench_timed)) {
+        return bench_original_ptr(x);
+    }
+    TRACE_ENTER(bench_timed);
+    int ret = bench_original_ptr(x);
+    TRACE_EXIT(bench_timed);
+    return ret;
+}
+
+static __thread int bench_countdown = TRACE_BENCH_SAMPLE_RATE;
+
+__attribute__((noinline)) static int bench_sampled(int x) {
+    if (!TRACE_ENABLED(bench_sampled) || --bench_countdown != 0) {
+        return bench_original_ptr(x);
+    }
+    bench_countdown = TRACE_BENCH_SAMPLE_RATE;
+    TRACE_ENTER(bench_sampled);
+    int ret = bench_original_ptr(x);
+    TRACE_EXIT(bench_sampled);
+    return ret;
+}
+
+typedef struct bench_layer {
+    const char* name;
+    bench_fn_t fn;
+} bench_layer_t;
+
+static const bench_layer_t layers[] = {
+    { "direct", bench_original },
+    { "trampoline", bench_trampoline },
+    { "disabled", bench_disabled },
+    { "record", bench_record },
+    { "timed", bench_timed },
+    { "sampled 1/64", bench_sampled }
+};
+#define LAYER_COUNT (int)(sizeof(layers) / sizeof(layers[0]))
+
+typedef struct bench_thread {
+    pthread_t thread;
+    // Nanoseconds spent per layer, summed over all rounds
+    uint64_t elapsed[LAYER_COUNT];
+    int sink;
+} bench_thread_t;
+
+static pthread_barrier_t barrier;
+static int rounds;
+
+static uint64_t now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void* bench_worker(void* arg) {
+    bench_thread_t* self = arg;
+    int x = 0;
+    for (int layer = 0; layer < LAYER_COUNT; layer++) {
+        // Called the way the game calls a hooked method, through a pointer
+        bench_fn_t volatile fn = layers[layer].fn;
+        for (int round = 0; round < rounds; round++) {
+            pthread_barrier_wait(&barrier);
+            uint64_t start = now();
+            for (int i = 0; i < TRACE_BENCH_ROUND; i++) {
+                x = fn(x);
+            }
+            self->elapsed[layer] += now() - start;
+            pthread_barrier_wait(&barrier);
+        }
+    }
+    self->sink = x;
+    return NULL;
+}
+
+// Runs every layer on `count` threads, fills in ns/event per layer (mean over the threads)
+static void bench_run(int count, double* result) {
+    bench_thread_t* threads = calloc(count, sizeof(bench_thread_t));
+    pthread_barrier_init(&barrier, NULL, count + 1);
+    for (int i = 0; i < count; i++) {
+        pthread_create(&threads[i].thread, NULL, bench_worker, &threads[i]);
+    }
+    for (int layer = 0; layer < LAYER_COUNT; layer++) {
+        for (int round = 0; round < rounds; round++) {
+            pthread_barrier_wait(&barrier);
+            pthread_barrier_wait(&barrier);
+            // Empty the buffers so the next round does not hit the drop path
+            trace_flush();
+        }
+    }
+    for (int i = 0; i < count; i++) {
+        pthread_join(threads[i].thread, NULL);
+    }
+    pthread_barrier_destroy(&barrier);
+    for (int layer = 0; layer < LAYER_COUNT; layer++) {
+        double total = 0;
+        for (int i = 0; i < count; i++) {
+            total += threads[i].elapsed[layer];
+        }
+        result[layer] = total / count / ((double)rounds * TRACE_BENCH_ROUND);
+    }
+    free(threads);
+    // Let the exited threads' buffers be freed before the next run claims them
+    trace_flush();
+}
+
+static void usage(const char* name) {
+    fprintf(stderr, "Usage: %s [-n calls_per_thread] [-t max_threads] [-o trace_output]\n", name);
+    fprintf(stderr, "  -n  calls per thread and layer (default 1000000)\n");
+    fprintf(stderr, "  -t  highest thread count, runs 1, 2, 4, ... up to it (default 8)\n");
+    fprintf(stderr, "  -o  where the trace goes (default /tmp/tracebench.bin)\n");
+}
+
+int main(int argc, char** argv) {
+    long calls = 1000000;
+    int max_threads = 8;
+    const char* output = "/tmp/tracebench.bin";
+    int opt;
+    while ((opt = getopt(argc, argv, "n:t:o:h")) != -1) {
+        switch (opt) {
+        case 'n':
+            calls = atol(optarg);
+            break;
+        case 't':
+            max_threads = atoi(optarg);
+            break;
+        case 'o':
+            output = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    // The flush thread does not record, so every buffer is free for the workers
+    if (max_threads < 1 || max_threads > TRACE_MAX_THREADS) {
+        fprintf(stderr, "Thread count must be between 1 and %d\n", TRACE_MAX_THREADS);
+        return 1;
+    }
+    rounds = (int)((calls + TRACE_BENCH_ROUND - 1) / TRACE_BENCH_ROUND);
+    if (rounds < 1) {
+        rounds = 1;
+    }
+
+    if (trace_init(output, "/nonexistent") != 0) {
+        return 1;
+    }
+    trace_register(&trace_bench_disabled);
+    trace_register(&trace_bench_record);
+    trace_register(&trace_bench_timed);
+    trace_register(&trace_bench_sampled);
+    __atomic_fetch_and(&trace_enabled[trace_bench_disabled.id >> 5], ~(1u << (trace_bench_disabled.id & 31)), __ATOMIC_RELAXED);
+
+    int counts[8];
+    int count_len = 0;
+    for (int t = 1; t <= max_threads && count_len < 8; t *= 2) {
+        counts[count_len++] = t;
+    }
+    double results[8][LAYER_COUNT];
+    for (int i = 0; i < count_len; i++) {
+        bench_run(counts[i], results[i]);
+    }
+
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    printf("%ld calls per thread and layer, %ld CPUs\n\n", (long)rounds * TRACE_BENCH_ROUND, cpus);
+    printf("ns/event %-12s", "");
+    for (int i = 0; i < count_len; i++) {
+        printf(" %7d thr", counts[i]);
+    }
+    printf("\n");
+    for (int layer = 0; layer < LAYER_COUNT; layer++) {
+        printf("%-21s", layers[layer].name);
+        for (int i = 0; i < count_len; i++) {
+            printf(" %11.1f", results[i][layer]);
+        }
+        printf("\n");
+    }
+    printf("\nAdded over trampoline\n");
+    for (int layer = 2; layer < LAYER_COUNT; layer++) {
+        printf("%-21s", layers[layer].name);
+        for (int i = 0; i < count_len; i++) {
+            printf(" %11.1f", results[i][layer] - results[i][1]);
+        }
+        printf("\n");
+    }
+    if (counts[count_len - 1] > cpus) {
+        printf("\nMore threads than CPUs, the higher thread counts include time spent preempted\n");
+    }
+    return 0;
+}
@@ -0,0 +1,111 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "livereader.h"
+
+// Prints live per method call rates from the temp mod's live export.
+// It has to run on the machine that writes the export: on the host against a host build of the tracer,
+// or built for the Quest and run from adb shell.
+
+static uint64_t counts[TRACE_MAX_HOOKS];
+static uint64_t frames = 0;
+
+static void count_record(void* context, const trace_record_header_t* header, const uint8_t* payload) {
+    // The export is written by another process, a torn or foreign record can carry any id
+    if (header->hook >= TRACE_MAX_HOOKS) {
+        return;
+    }
+    if (header->type == TRACE_RECORD_CALL || header->type == TRACE_RECORD_ENTER) {
+        counts[header->hook]++;
+    } else if (header->type == TRACE_RECORD_FRAME) {
+        frames++;
+    }
+}
+
+static int compare_counts(const void* a, const void* b) {
+    uint64_t x = counts[*(const uint16_t*)a];
+    uint64_t y = counts[*(const uint16_t*)b];
+    return x < y ? 1 : (x > y ? -1 : 0);
+}
+
+static double now_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void usage(const char* name) {
+    fprintf(stderr, "Usage: %s [-i interval_ms] [-n top] [-d duration_s] temptrace.live\n", name);
+}
+
+int main(int argc, char** argv) {
+    int interval = 1000;
+    int top = 20;
+    double duration = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "i:n:d:h")) != -1) {
+        switch (opt) {
+        case 'i':
+            interval = atoi(optarg);
+            break;
+        case 'n':
+            top = atoi(optarg);
+            break;
+        case 'd':
+            duration = atof(optarg);
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (optind >= argc || interval <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    trace_live_reader_t reader;
+    if (trace_live_open(&reader, argv[optind]) != 0) {
+        fprintf(stderr, "Could not open live trace: %s\n", argv[optind]);
+        return 1;
+    }
+    static uint16_t order[TRACE_MAX_HOOKS];
+    double start = now_seconds();
+    double last = start;
+    uint64_t lost = 0;
+    while (duration <= 0 || last - start < duration) {
+        usleep(interval * 1000);
+        memset(counts, 0, sizeof(counts));
+        frames = 0;
+        uint64_t records = trace_live_poll(&reader, count_record, NULL);
+        double now = now_seconds();
+        double elapsed = now - last;
+        last = now;
+        int count = 0;
+        for (int i = 0; i < TRACE_MAX_HOOKS; i++) {
+            if (counts[i] > 0) {
+                order[count++] = i;
+            }
+        }
+        qsort(order, count, sizeof(uint16_t), compare_counts);
+        printf("\n%.1f s: %.0f records/s, %.1f frames/s", now - start, records / elapsed, frames / elapsed);
+        if (reader.lost != lost) {
+            printf(", lost records %llu times (reading too slowly)", (unsigned long long)(reader.lost - lost));
+            lost = reader.lost;
+        }
+        printf("\n%-70s %12s\n", "Method", "Calls/s");
+        for (int i = 0; i < count && i < top; i++) {
+            const char* name = trace_live_hook_name(&reader, order[i]);
+            if (name) {
+                printf("%-70s %12.1f\n", name, counts[order[i]] / elapsed);
+            } else {
+                printf("hook_%-65u %12.1f\n", order[i], counts[order[i]] / elapsed);
+            }
+        }
+        fflush(stdout);
+    }
+    trace_live_close(&reader);
+    return 0;
+}
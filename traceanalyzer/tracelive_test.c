@@ -0,0 +1,150 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "../temp/trace.h"
+
+// Host test for tracelive: a host build of the tracer exports its thread buffers to a live file
+// while tracelive (the binary given as the argument) follows it from another process. Besides normal
+// call and frame records, the writer puts records with hook ids past TRACE_MAX_HOOKS into the export,
+// which the reader has to skip. Run with `make test`, which builds tracelive with bounds checking for it.
+
+#define LIVE_TEST_DIR "/tmp"
+#define LIVE_TEST_CONFIG LIVE_TEST_DIR "/tracelive_test.cfg"
+#define LIVE_TEST_EXPORT LIVE_TEST_DIR "/tracelive_test.live"
+#define LIVE_TEST_TRACE LIVE_TEST_DIR "/tracelive_test.bin"
+// How long tracelive reads, and how long the writer keeps writing (longer, so every interval sees records)
+#define LIVE_TEST_READ_S "1.5"
+#define LIVE_TEST_WRITE_MS 2000
+
+static int failures = 0;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { \
+        printf("FAIL %s:%i: ", __FILE__, __LINE__); \
+        printf(__VA_ARGS__); \
+        printf("\n"); \
+        failures++; \
+    } \
+} while (0)
+
+trace_hook_t live_test_often = { "LiveTest_Often", "", 0, 0, 0, 0, 0, 0 };
+trace_hook_t live_test_rarely = { "LiveTest_Rarely", "", 0, 0, 0, 0, 0, 0 };
+trace_hook_t live_test_frame = { "LiveTest_Frame", "", 0, 0, 0, 0, 0, 0 };
+// Never registered, the ids are set by hand to ones tracelive has no slot for
+trace_hook_t live_test_past_end = { "LiveTest_PastEnd", "", 0, TRACE_MAX_HOOKS, 0, 0, 0, 0 };
+trace_hook_t live_test_last_id = { "LiveTest_LastId", "", 0, 0xFFFF, 0, 0, 0, 0 };
+
+// Starts tracelive with its stdout going to a pipe, returns the read end
+static FILE* start_reader(const char* binary, pid_t* pid) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+        return NULL;
+    }
+    *pid = fork();
+    if (*pid < 0) {
+        return NULL;
+    }
+    if (*pid == 0) {
+        dup2(fds[1], STDOUT_FILENO);
+        close(fds[0]);
+        close(fds[1]);
+        execl(binary, binary, "-i", "250", "-d", LIVE_TEST_READ_S, "-n", "10", LIVE_TEST_EXPORT, (char*)NULL);
+        perror("exec");
+        _exit(127);
+    }
+    close(fds[1]);
+    return fdopen(fds[0], "r");
+}
+
+static void write_records() {
+    struct timespec delay = { 0, 1000000 };
+    for (int i = 0; i < LIVE_TEST_WRITE_MS; i++) {
+        for (int j = 0; j < 4; j++) {
+            trace_emit(&live_test_often, TRACE_RECORD_CALL, NULL);
+        }
+        trace_emit(&live_test_rarely, TRACE_RECORD_CALL, NULL);
+        trace_emit(&live_test_past_end, TRACE_RECORD_CALL, NULL);
+        trace_emit(&live_test_last_id, TRACE_RECORD_ENTER, NULL);
+        trace_frame(&live_test_frame);
+        nanosleep(&delay, NULL);
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s path/to/tracelive\n", argv[0]);
+        return 1;
+    }
+    FILE* config = fopen(LIVE_TEST_CONFIG, "w");
+    if (!config) {
+        printf("Could not write %s\n", LIVE_TEST_CONFIG);
+        return 1;
+    }
+    fprintf(config, "live %s\n", LIVE_TEST_EXPORT);
+    fclose(config);
+    if (trace_init(LIVE_TEST_TRACE, LIVE_TEST_CONFIG) != 0) {
+        printf("Could not start the tracer\n");
+        return 1;
+    }
+    trace_register(&live_test_often);
+    trace_register(&live_test_rarely);
+    trace_register(&live_test_frame);
+
+    pid_t pid;
+    FILE* output = start_reader(argv[1], &pid);
+    if (!output) {
+        printf("Could not start %s\n", argv[1]);
+        return 1;
+    }
+    write_records();
+
+    char line[256];
+    int intervals = 0;
+    int often_first = 0;
+    int rarely = 0;
+    int unknown = 0;
+    int frames = 0;
+    char* previous = NULL;
+    while (fgets(line, sizeof(line), output)) {
+        double seconds, records, rate;
+        if (sscanf(line, "%lf s: %lf records/s, %lf frames/s", &seconds, &records, &rate) == 3) {
+            intervals++;
+            frames += rate > 0;
+        }
+        if (strncmp(line, "LiveTest_Often", 14) == 0 && previous && strncmp(previous, "Method", 6) == 0) {
+            often_first++;
+        }
+        if (strncmp(line, "LiveTest_Rarely", 15) == 0) {
+            rarely++;
+        }
+        if (strncmp(line, "hook_", 5) == 0 || strncmp(line, "LiveTest_PastEnd", 16) == 0 || strncmp(line, "LiveTest_LastId", 15) == 0) {
+            unknown++;
+        }
+        free(previous);
+        previous = strdup(line);
+    }
+    free(previous);
+    fclose(output);
+    int status;
+    waitpid(pid, &status, 0);
+
+    CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0, "tracelive did not exit cleanly (status %i)", status);
+    CHECK(intervals >= 4, "expected at least 4 intervals, got %i", intervals);
+    CHECK(often_first == intervals, "LiveTest_Often should top all %i intervals, topped %i", intervals, often_first);
+    CHECK(rarely == intervals, "LiveTest_Rarely should be listed in all %i intervals, was in %i", intervals, rarely);
+    CHECK(frames == intervals, "expected frames in all %i intervals, got %i", intervals, frames);
+    CHECK(unknown == 0, "records with out of range hook ids were counted %i times", unknown);
+    unlink(LIVE_TEST_CONFIG);
+    unlink(LIVE_TEST_EXPORT);
+    unlink(LIVE_TEST_TRACE);
+    if (failures > 0) {
+        printf("%i checks failed\n", failures);
+        return 1;
+    }
+    printf("All tracelive tests passed\n");
+    return 0;
+}
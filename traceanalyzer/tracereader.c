@@ -0,0 +1,244 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "tracereader.h"
+#include "../temp/tracecompress.h"
+
+// Size of the mapped window, grown for the rare read (like a large index) that does not fit
+#define TRACE_READER_WINDOW (64ull * 1024 * 1024)
+
+// Returns a pointer to `len` bytes at the current position, or NULL if the file is too short.
+static const uint8_t* trace_reader_get(trace_reader_t* reader, uint64_t len) {
+    if (reader->pos + len > reader->file_size) {
+        return NULL;
+    }
+    if (reader->map && reader->pos >= reader->map_offset && reader->pos + len <= reader->map_offset + reader->map_length) {
+        return reader->map + (reader->pos - reader->map_offset);
+    }
+    if (reader->map) {
+        munmap(reader->map, reader->map_length);
+        reader->map = NULL;
+    }
+    uint64_t page = sysconf(_SC_PAGESIZE);
+    uint64_t offset = reader->pos & ~(page - 1);
+    uint64_t length = reader->window;
+    if (length < reader->pos - offset + len) {
+        length = reader->pos - offset + len;
+    }
+    if (offset + length > reader->file_size) {
+        length = reader->file_size - offset;
+    }
+    void* map = mmap(NULL, length, PROT_READ, MAP_PRIVATE, reader->fd, offset);
+    if (map == MAP_FAILED) {
+        return NULL;
+    }
+    madvise(map, length, MADV_SEQUENTIAL);
+    reader->map = map;
+    reader->map_offset = offset;
+    reader->map_length = length;
+    return reader->map + (reader->pos - reader->map_offset);
+}
+
+static void trace_reader_load_index(trace_reader_t* reader) {
+    if (reader->file_size < sizeof(trace_file_header_t) + sizeof(trace_file_footer_t)) {
+        return;
+    }
+    uint64_t start = reader->pos;
+    reader->pos = reader->file_size - sizeof(trace_file_footer_t);
+    const uint8_t* data = trace_reader_get(reader, sizeof(trace_file_footer_t));
+    trace_file_footer_t footer;
+    memcpy(&footer, data, sizeof(footer));
+    uint64_t index_size = (uint64_t)footer.block_count * sizeof(trace_index_entry_t);
+    if (memcmp(footer.magic, TRACE_FOOTER_MAGIC, sizeof(footer.magic)) == 0 && footer.index_offset + index_size + sizeof(footer) == reader->file_size) {
+        reader->pos = footer.index_offset;
+        data = trace_reader_get(reader, index_size);
+        if (data) {
+            reader->index = malloc(index_size + 1);
+            memcpy(reader->index, data, index_size);
+            reader->index_count = footer.block_count;
+            reader->data_end = footer.index_offset;
+        }
+    }
+    reader->pos = start;
+}
+
+// Reads and decodes the block at the current position
+static trace_reader_status_t trace_reader_next_block(trace_reader_t* reader) {
+    if (reader->pos >= reader->data_end) {
+        return TRACE_READER_END;
+    }
+    const uint8_t* data = trace_reader_get(reader, sizeof(trace_block_header_t));
+    if (!data) {
+        return TRACE_READER_TRUNCATED;
+    }
+    trace_block_header_t header;
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, TRACE_BLOCK_MAGIC, sizeof(header.magic)) != 0) {
+        // Start of an older footer that was being overwritten
+        return TRACE_READER_TRUNCATED;
+    }
+    if (header.raw_size > TRACE_BLOCK_SIZE + TRACE_MAX_RECORD_ENCODED) {
+        return TRACE_READER_ERROR;
+    }
+    data = trace_reader_get(reader, sizeof(header) + header.stored_size);
+    if (!data) {
+        return TRACE_READER_TRUNCATED;
+    }
+    data += sizeof(header);
+    if (header.flags & TRACE_BLOCK_STORED) {
+        if (header.stored_size != header.raw_size) {
+            return TRACE_READER_ERROR;
+        }
+        memcpy(reader->block, data, header.raw_size);
+    } else if (trace_lz4_decompress(data, header.stored_size, reader->block, header.raw_size) != (int)header.raw_size) {
+        return TRACE_READER_ERROR;
+    }
+    reader->pos += sizeof(header) + header.stored_size;
+    reader->block_len = header.raw_size;
+    reader->block_pos = 0;
+    reader->previous = header.base_timestamp;
+    return TRACE_READER_RECORD;
+}
+
+static trace_reader_status_t trace_reader_next_compressed(trace_reader_t* reader, trace_record_header_t* header, const uint8_t** payload) {
+    while (reader->block_pos >= reader->block_len) {
+        trace_reader_status_t status = trace_reader_next_block(reader);
+        if (status != TRACE_READER_RECORD) {
+            return status;
+        }
+    }
+    const uint8_t* data = reader->block + reader->block_pos;
+    int left = reader->block_len - reader->block_pos;
+    uint64_t values[5];
+    int n = 0;
+    for (int i = 0; i < 5; i++) {
+        int len = trace_varint_get(data + n, left - n, &values[i]);
+        if (len == 0) {
+            return TRACE_READER_ERROR;
+        }
+        n += len;
+    }
+    if (values[4] > (uint64_t)(left - n)) {
+        return TRACE_READER_ERROR;
+    }
+    memset(header, 0, sizeof(*header));
+    header->type = (uint8_t)values[0];
+    header->hook = (uint16_t)values[1];
+    header->tid = (uint32_t)values[2];
+    header->timestamp = reader->previous + trace_unzigzag(values[3]);
+    header->size = (uint16_t)values[4];
+    reader->previous = header->timestamp;
+    *payload = data + n;
+    reader->block_pos += n + header->size;
+    return TRACE_READER_RECORD;
+}
+
+void trace_reader_seek(trace_reader_t* reader, uint64_t timestamp) {
+    if (reader->header.version != TRACE_VERSION_COMPRESSED) {
+        return;
+    }
+    if (reader->index) {
+        for (uint32_t i = 0; i < reader->index_count; i++) {
+            if (reader->index[i].max_timestamp >= timestamp) {
+                if (reader->index[i].offset > reader->pos) {
+                    reader->pos = reader->index[i].offset;
+                    reader->block_len = 0;
+                    reader->block_pos = 0;
+                }
+                return;
+            }
+        }
+        reader->pos = reader->data_end;
+        reader->block_len = 0;
+        reader->block_pos = 0;
+        return;
+    }
+    // No index, skip whole blocks by their headers
+    while (reader->pos < reader->data_end) {
+        const uint8_t* data = trace_reader_get(reader, sizeof(trace_block_header_t));
+        if (!data) {
+            return;
+        }
+        trace_block_header_t header;
+        memcpy(&header, data, sizeof(header));
+        if (memcmp(header.magic, TRACE_BLOCK_MAGIC, sizeof(header.magic)) != 0 || header.max_timestamp >= timestamp) {
+            return;
+        }
+        reader->pos += sizeof(header) + header.stored_size;
+        reader->block_len = 0;
+        reader->block_pos = 0;
+    }
+}
+
+int trace_reader_open(trace_reader_t* reader, const char* path) {
+    memset(reader, 0, sizeof(*reader));
+    reader->window = TRACE_READER_WINDOW;
+    reader->fd = open(path, O_RDONLY);
+    if (reader->fd < 0) {
+        return -1;
+    }
+    struct stat st;
+    if (fstat(reader->fd, &st) != 0) {
+        close(reader->fd);
+        return -1;
+    }
+    reader->file_size = st.st_size;
+    const uint8_t* header = trace_reader_get(reader, sizeof(trace_file_header_t));
+    if (!header) {
+        trace_reader_close(reader);
+        return -1;
+    }
+    memcpy(&reader->header, header, sizeof(trace_file_header_t));
+    if (memcmp(reader->header.magic, TRACE_MAGIC, sizeof(TRACE_MAGIC)) != 0) {
+        trace_reader_close(reader);
+        return -1;
+    }
+    reader->pos += sizeof(trace_file_header_t);
+    reader->data_end = reader->file_size;
+    if (reader->header.version == TRACE_VERSION_COMPRESSED) {
+        reader->block = malloc(TRACE_BLOCK_SIZE + TRACE_MAX_RECORD_ENCODED);
+        trace_reader_load_index(reader);
+    }
+    return 0;
+}
+
+trace_reader_status_t trace_reader_next(trace_reader_t* reader, trace_record_header_t* header, const uint8_t** payload) {
+    if (reader->header.version == TRACE_VERSION_COMPRESSED) {
+        return trace_reader_next_compressed(reader, header, payload);
+    }
+    if (reader->pos == reader->file_size) {
+        return TRACE_READER_END;
+    }
+    const uint8_t* data = trace_reader_get(reader, sizeof(trace_record_header_t));
+    if (!data) {
+        return TRACE_READER_TRUNCATED;
+    }
+    memcpy(header, data, sizeof(trace_record_header_t));
+    data = trace_reader_get(reader, sizeof(trace_record_header_t) + header->size);
+    if (!data) {
+        return TRACE_READER_TRUNCATED;
+    }
+    *payload = data + sizeof(trace_record_header_t);
+    reader->pos += sizeof(trace_record_header_t) + header->size;
+    return TRACE_READER_RECORD;
+}
+
+void trace_reader_close(trace_reader_t* reader) {
+    free(reader->index);
+    reader->index = NULL;
+    free(reader->block);
+    reader->block = NULL;
+    if (reader->map) {
+        munmap(reader->map, reader->map_length);
+        reader->map = NULL;
+    }
+    if (reader->fd >= 0) {
+        close(reader->fd);
+        reader->fd = -1;
+    }
+}
@@ -0,0 +1,49 @@
+#ifndef TRACEREADER_H
+#define TRACEREADER_H
+
+#include <stdint.h>
+#include "../temp/trace.h"
+
+// Streams records out of a trace file written by the temp mod, raw or compressed.
+// The file is mapped a window at a time and compressed traces are decoded a block at a time,
+// so memory use does not depend on the size of the trace.
+
+typedef enum trace_reader_status {
+    TRACE_READER_RECORD = 1,
+    TRACE_READER_END = 0,
+    // The file ends in the middle of a record (e.g. the game crashed while writing)
+    TRACE_READER_TRUNCATED = -1,
+    TRACE_READER_ERROR = -2
+} trace_reader_status_t;
+
+typedef struct trace_reader {
+    int fd;
+    uint64_t file_size;
+    uint64_t pos;
+    uint8_t* map;
+    uint64_t map_offset;
+    uint64_t map_length;
+    uint64_t window;
+    trace_file_header_t header;
+    // Blocks end here, either at the index or at the end of the file
+    uint64_t data_end;
+    // Index from the footer, NULL if the trace was cut short
+    trace_index_entry_t* index;
+    uint32_t index_count;
+    // Decoded block of a compressed trace
+    uint8_t* block;
+    int block_len;
+    int block_pos;
+    uint64_t previous;
+} trace_reader_t;
+
+// Returns 0 on success
+int trace_reader_open(trace_reader_t* reader, const char* path);
+// Reads the next record. The payload pointer is valid until the next call.
+trace_reader_status_t trace_reader_next(trace_reader_t* reader, trace_record_header_t* header, const uint8_t** payload);
+// Moves to the first block that may contain records at or after the timestamp.
+// Uses the index when there is one, otherwise skips blocks by their headers. Raw traces are not moved.
+void trace_reader_seek(trace_reader_t* reader, uint64_t timestamp);
+void trace_reader_close(trace_reader_t* reader);
+
+#endif /* TRACEREADER_H */
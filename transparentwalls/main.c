@@ -9,32 +9,182 @@
 #include <linux/limits.h>
 #include <sys/sendfile.h>
 #include <sys/stat.h>
+#include <stddef.h>
 
-#include "../beatsaber-hook/shared/inline-hook/inlineHook.h"
-#include "../beatsaber-hook/shared/utils/utils.h"
+#include "../core/core.h"
+#include "../beatsaber-hook/jsmn/jsmn.h"
+#include "../temp/main.h"
 
 #undef log
 #define log(...) __android_log_print(ANDROID_LOG_INFO, "QuestHook", "[TransparentWalls] " __VA_ARGS__)
 
-// NOW JUST NEED TO FIGURE OUT THE LIV CAMERA STUFF
-// LIV.SpectatorLayerMask foffset: 0x18
+#define CONFIG_FILE "/sdcard/Android/data/com.beatgames.beatsaber/files/mods/TransparentWallsConfig.json"
+#define MAX_JSON_TOKENS 64
+
+// MirrorRenderer._reflectLayers (LayerMask, a single int): 0xC
+#define MirrorRenderer_reflectLayers_offset 0xC
+// LIV.SpectatorLayerMask (LayerMask, a single int), from the layout in temp/main.h
+#define LIV_SpectatorLayerMask_offset offsetof(LIV_t, SpectatorLayerMask)
+_Static_assert(offsetof(LIV_t, SpectatorLayerMask) == 0x18, "LIV.SpectatorLayerMask is not at 0x18 in the dump, update temp/main.h");
+
+typedef enum camera_type {
+    CAMERA_HMD,
+    // LIV's spectator camera
+    CAMERA_LIV,
+    CAMERA_MIRROR,
+    CAMERA_TYPE_COUNT
+} camera_type_t;
+
+// What TransparentWallsConfig.json says. Only read at load time, to build the mask plans.
+typedef struct walls_config {
+    // Layer the wall cubes are moved to, 0-31
+    int wall_layer;
+    // Whether each camera type renders walls
+    char walls_visible[CAMERA_TYPE_COUNT];
+    // More layers the LIV camera renders
+    int liv_extra_layers;
+    // Offset of LIV.SpectatorLayerMask, checked by valid_liv_layer_mask_offset
+    int liv_layer_mask_offset;
+} walls_config_t;
+
+// The mask a camera type ends up with: (mask & and_mask) | or_mask
+typedef struct mask_plan {
+    int and_mask;
+    int or_mask;
+} mask_plan_t;
+
+static mask_plan_t mask_plans[CAMERA_TYPE_COUNT];
+static int wall_layer = 25;
+static int liv_layer_mask_offset = LIV_SpectatorLayerMask_offset;
+
+static inline int apply_mask_plan(camera_type_t type, int mask) {
+    return (mask & mask_plans[type].and_mask) | mask_plans[type].or_mask;
+}
+
+static void createdefaultconfig(walls_config_t* config) {
+    config->wall_layer = 25;
+    config->walls_visible[CAMERA_HMD] = '\0';
+    config->walls_visible[CAMERA_LIV] = '\1';
+    config->walls_visible[CAMERA_MIRROR] = '\1';
+    config->liv_extra_layers = 1 << 27;
+    config->liv_layer_mask_offset = LIV_SpectatorLayerMask_offset;
+}
+
+// The LIV hook writes an int at this offset, so it has to be an aligned int inside a LIV object, after the object header
+static char valid_liv_layer_mask_offset(int offset) {
+    return offset >= (int)offsetof(LIV_t, TrackedSpaceOrigin) && offset % sizeof(int) == 0 && offset <= (int)(sizeof(LIV_t) - sizeof(int)) ? '\1' : '\0';
+}
+
+static void createdefaultjson(const char* filename) {
+    const char* js = "{\n"
+    "\t\"wallLayer\": 25,\n"
+    "\t\"hmd\": false,\n"
+    "\t\"liv\": true,\n"
+    "\t\"mirror\": true,\n"
+    "\t\"livExtraLayers\": [27]\n"
+    "}\n";
+    if (writefile(filename, js) == 0) {
+        log("Created default config at path: %s", filename);
+    } else {
+        log("Could not create default config at path: %s", filename);
+    }
+}
+
+static void loadconfig(const char* filename, walls_config_t* config) {
+    createdefaultconfig(config);
+    char* js = readfile(filename);
+    if (!js) {
+        log("Config at path: %s does not exist, using defaults!", filename);
+        createdefaultjson(filename);
+        return;
+    }
+    jsmntok_t* tokens = malloc(MAX_JSON_TOKENS * sizeof(jsmntok_t));
+    int count = parsejson(js, &tokens, MAX_JSON_TOKENS);
+    if (count < 0) {
+        log("Invalid config JSON at path: %s, using defaults!", filename);
+        free(tokens);
+        free(js);
+        return;
+    }
+    for (int i = 0; i + 1 < count; i++) {
+        if (tokens[i].size == 0) {
+            continue;
+        }
+        char* key = bufferfromtoken(js, tokens[i]);
+        if (strcmp(key, "wallLayer") == 0) {
+            int layer = intfromjson(js, tokens[i + 1]);
+            if (layer >= 0 && layer < 32) {
+                config->wall_layer = layer;
+            } else {
+                log("wallLayer %i is not a layer, using %i!", layer, config->wall_layer);
+            }
+            i++;
+        } else if (strcmp(key, "hmd") == 0) {
+            config->walls_visible[CAMERA_HMD] = boolfromjson(js, tokens[i + 1]);
+            i++;
+        } else if (strcmp(key, "liv") == 0) {
+            config->walls_visible[CAMERA_LIV] = boolfromjson(js, tokens[i + 1]);
+            i++;
+        } else if (strcmp(key, "mirror") == 0) {
+            config->walls_visible[CAMERA_MIRROR] = boolfromjson(js, tokens[i + 1]);
+            i++;
+        } else if (strcmp(key, "livExtraLayers") == 0) {
+            int layers = tokens[i + 1].size;
+            config->liv_extra_layers = 0;
+            for (int j = 0; j < layers && i + 2 + j < count; j++) {
+                int layer = intfromjson(js, tokens[i + 2 + j]);
+                if (layer >= 0 && layer < 32) {
+                    config->liv_extra_layers |= 1 << layer;
+                }
+            }
+            i += 1 + layers;
+        } else if (strcmp(key, "livLayerMaskOffset") == 0) {
+            int offset = intfromjson(js, tokens[i + 1]);
+            if (valid_liv_layer_mask_offset(offset)) {
+                config->liv_layer_mask_offset = offset;
+            } else {
+                log("livLayerMaskOffset %i is not an int field of LIV, using 0x%X!", offset, (unsigned int)LIV_SpectatorLayerMask_offset);
+                config->liv_layer_mask_offset = LIV_SpectatorLayerMask_offset;
+            }
+            i++;
+        }
+        free(key);
+    }
+    free(tokens);
+    free(js);
+    log("Loaded config at path: %s", filename);
+}
+
+// Compiles the config into one mask plan per camera type, so hooks never look at the config
+static void createmaskplans(const walls_config_t* config) {
+    int wall_bit = 1 << config->wall_layer;
+    for (int type = 0; type < CAMERA_TYPE_COUNT; type++) {
+        mask_plans[type].and_mask = config->walls_visible[type] ? ~0 : ~wall_bit;
+        mask_plans[type].or_mask = config->walls_visible[type] ? wall_bit : 0;
+    }
+    mask_plans[CAMERA_LIV].or_mask |= config->liv_extra_layers;
+    mask_plans[CAMERA_LIV].and_mask |= config->liv_extra_layers;
+    wall_layer = config->wall_layer;
+    liv_layer_mask_offset = config->liv_layer_mask_offset;
+    for (int type = 0; type < CAMERA_TYPE_COUNT; type++) {
+        log("Camera type %i mask plan: & 0x%08X | 0x%08X", type, mask_plans[type].and_mask, mask_plans[type].or_mask);
+    }
+}
+
+// LIV.SpectatorLayerMask is at liv_layer_mask_offset (LIV_SpectatorLayerMask_offset unless the config moves it)
 // LIV.ctor: 0x136E7BC
-// Sadly, I don't know exactly how large LayerMask struct is
-// I have the sneaking suspicion that it is larger than 4 bytes, but I could be wrong.
-// Let's try it as 4 bytes for now, with good logging
-// From the Ghidra dump, it looks like it is an undefined 4 (making me believe it is just one 4 byte int)
-// It's also entirely possible that the LIV constructor is not good enough and that I need to do it later
 MAKE_HOOK(LIV_ctor, 0x136E7BC, void, void* self) {
-    log("Entering LIV.ctor hook...");
-    log("Calling orig...");
     LIV_ctor(self);
-    log("Attempting to get old layer mask...");
-    int toChange = *(int*)(self + 0x18) | (1 << 25);
-    log("Attempting to set new layer to be the OR between current and 25...");
-    *(int*)(self + 0x18) = toChange;
-    log("Attempting to set new layer to be the OR between current and 27...");
-    *(int*)(self + 0x18) = toChange | (1 << 27);
-    log("Completed LIV.ctor!");
+    int* mask = (int*)(self + liv_layer_mask_offset);
+    *mask = apply_mask_plan(CAMERA_LIV, *mask);
+    log("Set LIV.SpectatorLayerMask to 0x%08X", *mask);
+}
+
+// MirrorRenderer.Awake: 0x1335518
+MAKE_HOOK(MirrorRenderer_Awake, 0x1335518, void, void* self) {
+    MirrorRenderer_Awake(self);
+    int* mask = (int*)(self + MirrorRenderer_reflectLayers_offset);
+    *mask = apply_mask_plan(CAMERA_MIRROR, *mask);
 }
 
 // INTERESTED IN StrechableCube.Awake: 0x12F05D4
@@ -43,56 +193,151 @@ MAKE_HOOK(LIV_ctor, 0x136E7BC, void, void* self) {
 // can take gameObject field and get the field for layer and change it (might even be a property!)
 // IT'S A PROPERTY, YAY! 0xC76FD4
 
+// Component.get_gameObject: 0xC31C10
+#define Component_get_gameObject_offset 0xC31C10
+// GameObject.set_layer: 0xC76FD4
+#define GameObject_set_layer_offset 0xC76FD4
+// Time.get_frameCount, looked up by name on the first Awake. Only used to bucket the counters by frame.
+static int (*Time_get_frameCount)(void) = NULL;
+static char frame_count_looked_up = '\0';
+
+static void* (*Component_get_gameObject)(void*) = NULL;
+static void (*GameObject_set_layer)(void*, int) = NULL;
+
+// Reported and reset at every scene transition
+typedef struct wall_counters {
+    // Cubes moved to the wall layer
+    unsigned int cubes;
+    // Frames in which at least one cube spawned, and the most cubes that spawned in one of them
+    unsigned int spawn_frames;
+    unsigned int max_per_frame;
+    // The frame cubes_this_frame counts
+    int frame;
+    unsigned int cubes_this_frame;
+} wall_counters_t;
+
+static wall_counters_t wall_counters;
+
+static void count_cube() {
+    if (!frame_count_looked_up) {
+        Time_get_frameCount = core_il2cpp_method("UnityEngine.CoreModule", "UnityEngine", "Time", "get_frameCount", 0);
+        frame_count_looked_up = '\1';
+        if (!Time_get_frameCount) {
+            log("Could not find Time.get_frameCount, counting every cube as its own frame!");
+        }
+    }
+    int frame = Time_get_frameCount ? Time_get_frameCount() : -1;
+    if (frame != wall_counters.frame || frame == -1 || wall_counters.spawn_frames == 0) {
+        wall_counters.frame = frame;
+        wall_counters.cubes_this_frame = 0;
+        wall_counters.spawn_frames++;
+    }
+    wall_counters.cubes++;
+    wall_counters.cubes_this_frame++;
+    if (wall_counters.cubes_this_frame > wall_counters.max_per_frame) {
+        wall_counters.max_per_frame = wall_counters.cubes_this_frame;
+    }
+}
+
+static void set_wall_layer(void* cube) {
+    void* go = Component_get_gameObject(cube);
+    if (go) {
+        GameObject_set_layer(go, wall_layer);
+    }
+}
+
+// Each cube is moved to the wall layer in its Awake, before it can render
 MAKE_HOOK(StretchableCube_Awake, 0x12F05D4, void, void* self) {
-    int layer = 25;
-    log("Entering StretchableCube.Awake hook...");
-    log("Calling orig...");
     StretchableCube_Awake(self);
-    log("Attempting to get GameObject pointer...");
-    void* (*get_go)(void*) = (void*)getRealOffset(0xC31C10);
-    void* go = (*get_go)(self);
-    log("Attempting to set layer...");
-    void (*set_layer)(void*, int) = (void*)getRealOffset(0xC76FD4);
-    set_layer(go, layer);
-    log("Completed StretchableCube.Awake!");
+    set_wall_layer(self);
+    count_cube();
+}
+
+static void report_wall_counters() {
+    if (wall_counters.cubes > 0) {
+        log("Moved %u cubes to the wall layer in %u frames with spawns, at most %u in one frame, %.1f per frame", wall_counters.cubes, wall_counters.spawn_frames, wall_counters.max_per_frame, (double)wall_counters.cubes / wall_counters.spawn_frames);
+    }
+    memset(&wall_counters, 0, sizeof(wall_counters));
 }
 
-MAKE_HOOK(Camera_get_cullingMask, 0xC2DF20, int, void* camera) {
+// Camera.get_cullingMask: 0xC2DF20
+#define Camera_get_cullingMask_offset 0xC2DF20
+// Camera.set_cullingMask: 0xC2DFB0
+#define Camera_set_cullingMask_offset 0xC2DFB0
+// Camera.get_main: 0xC2F6D4
+#define Camera_get_main_offset 0xC2F6D4
+
+#ifdef TRANSPARENTWALLS_TRACE_CAMERA
+// Debug builds only (add -DTRANSPARENTWALLS_TRACE_CAMERA to LOCAL_CFLAGS): Unity reads the mask for every
+// camera every frame, so these log a lot and cost a trampoline on the render path.
+MAKE_HOOK(Camera_get_cullingMask, Camera_get_cullingMask_offset, int, void* camera) {
     log("Entering Camera.get_cullingMask hook...");
     return Camera_get_cullingMask(camera);
 }
 
-MAKE_HOOK(Camera_set_cullingMask, 0xC2DFB0, void, void* camera, int value) {
+MAKE_HOOK(Camera_set_cullingMask, Camera_set_cullingMask_offset, void, void* camera, int value) {
     log("Entering Camera.set_cullingMask hook...");
     Camera_set_cullingMask(camera, value);
     log("Completed Camera.set_cullingMask!");
 }
+#else
+// Called directly, the mod does not hook them
+static int (*Camera_get_cullingMask)(void*) = NULL;
+static void (*Camera_set_cullingMask)(void*, int) = NULL;
+#endif
+static void* (*Camera_get_main)(void) = NULL;
+
+// The camera the HMD mask plan was last applied to. Only compared, never dereferenced.
+static void* masked_camera = NULL;
 
-MAKE_HOOK(ObstacleController_ctor, 0x13B0C60, void, void* self) {
-    log("Entering ObstacleController.ctor...");
-    log("Attemping to get Camera...");
-    void* (*fun_ptr)(void) = (void*)getRealOffset(0xC2F6D4);
-    void* cam = (*fun_ptr)();
-    log("Attempting to get old culling mask...");
+// Applies the HMD mask plan to the main camera. Camera.main is a tag search, so this runs once per scene
+// instead of for every wall.
+static void apply_camera_mask() {
+    void* cam = Camera_get_main();
+    if (!cam) {
+        return;
+    }
     int mask = Camera_get_cullingMask(cam);
-    log("Attempting to transform Camera culling mask...");
-    mask &= ~(1 << 25);
-    log("Attempting to call Camera.set_cullingMask...");
-    Camera_set_cullingMask(cam, mask);
-    log("Completed ObstacleController.ctor!");
+    int planned = apply_mask_plan(CAMERA_HMD, mask);
+    if (cam == masked_camera && mask == planned) {
+        return;
+    }
+    log("Setting the culling mask of %s Camera to 0x%08X...", cam == masked_camera ? "the same" : "a new", planned);
+    Camera_set_cullingMask(cam, planned);
+    masked_camera = cam;
+}
+
+// GameScenesManagerSO.HandleExecutorTransitionDidFinish: 0x132C338
+MAKE_HOOK(GameScenesManagerSO_HandleExecutorTransitionDidFinish, 0x132C338, void, void* self) {
+    GameScenesManagerSO_HandleExecutorTransitionDidFinish(self);
+    report_wall_counters();
+    apply_camera_mask();
 }
 
 __attribute__((constructor)) void lib_main()
 {
+    walls_config_t config;
+    loadconfig(CONFIG_FILE, &config);
+    createmaskplans(&config);
     log("Installing Transparent Walls hooks...");
     log("Installing LIV.ctor hook!");
     INSTALL_HOOK(LIV_ctor);
-    log("Installing ObstacleController.ctor hook!");
-    INSTALL_HOOK(ObstacleController_ctor);
+    log("Installing MirrorRenderer.Awake hook!");
+    INSTALL_HOOK(MirrorRenderer_Awake);
+    log("Installing GameScenesManagerSO.HandleExecutorTransitionDidFinish hook!");
+    INSTALL_HOOK(GameScenesManagerSO_HandleExecutorTransitionDidFinish);
+#ifdef TRANSPARENTWALLS_TRACE_CAMERA
     log("Installing Camera.get_cullingMask hook!");
     INSTALL_HOOK(Camera_get_cullingMask);
     log("Installing Camera.set_cullingMask hook!");
     INSTALL_HOOK(Camera_set_cullingMask);
+#else
+    Camera_get_cullingMask = (void*)getRealOffset(Camera_get_cullingMask_offset);
+    Camera_set_cullingMask = (void*)getRealOffset(Camera_set_cullingMask_offset);
+#endif
+    Camera_get_main = (void*)getRealOffset(Camera_get_main_offset);
+    Component_get_gameObject = (void*)getRealOffset(Component_get_gameObject_offset);
+    GameObject_set_layer = (void*)getRealOffset(GameObject_set_layer_offset);
     log("Installing StretchableCube.Awake hook!");
     INSTALL_HOOK(StretchableCube_Awake);
     log("Completed installing hooks!");
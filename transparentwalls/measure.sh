@@ -0,0 +1,37 @@
+#!/bin/bash
+# Frame time of TransparentWalls with and without the Camera.cullingMask hooks, on the headset.
+# Usage: ./measure.sh before|after
+#   before: built with -DTRANSPARENTWALLS_TRACE_CAMERA, hooking and logging cullingMask like the old mod
+#   after:  the normal build
+# Loads the temp tracer with frame markers only, waits while a wall-heavy map is played, then pulls the
+# trace and prints the frame time summary. Run it once per variant on the same map and compare.
+# Each run's summary is appended to measurements.txt, with the date, variant and map, to be committed.
+set -e
+MODS=/sdcard/Android/data/com.beatgames.beatsaber/files/mods
+case "$1" in
+    before) CFLAGS=-DTRANSPARENTWALLS_TRACE_CAMERA ;;
+    after) CFLAGS= ;;
+    *) echo "Usage: $0 before|after"; exit 1 ;;
+esac
+(cd ../core && ndk-build NDK_PROJECT_PATH=. APP_BUILD_SCRIPT=./Android.mk NDK_APPLICATION_MK=./Application.mk)
+adb push ../core/libs/armeabi-v7a/lib0questhookcore.so $MODS/lib0questhookcore.so
+# Left over from before the core was renamed to load first
+adb shell rm -f $MODS/libquesthookcore.so $MODS/libgameplayevents.so
+ndk-build -B NDK_PROJECT_PATH=. APP_BUILD_SCRIPT=./Android.mk NDK_APPLICATION_MK=./Application.mk APP_CFLAGS="$CFLAGS"
+adb push libs/armeabi-v7a/libtransparentwalls.so $MODS/libtransparentwalls.so
+(cd ../temp && ndk-build NDK_PROJECT_PATH=. APP_BUILD_SCRIPT=./Android.mk NDK_APPLICATION_MK=./Application.mk)
+adb push ../temp/libs/armeabi-v7a/temphookmod.so $MODS/temphookmod.so
+# Only the frame marker, so the tracer itself costs next to nothing
+printf 'disable *\nenable AudioTimeSyncController_Update\n' > /tmp/TempTrace.cfg
+adb push /tmp/TempTrace.cfg $MODS/TempTrace.cfg
+adb shell rm -f $MODS/temptrace.bin
+adb shell am force-stop com.beatgames.beatsaber
+adb shell am start com.beatgames.beatsaber/com.unity3d.player.UnityPlayerActivity
+read -p "Map played (the same for before and after): " MAP
+read -p "Play the map, then press enter to pull the trace..."
+adb shell am force-stop com.beatgames.beatsaber
+adb pull $MODS/temptrace.bin temptrace-$1.bin
+(cd ../traceanalyzer && make traceanalyzer)
+SUMMARY=$(../traceanalyzer/traceanalyzer -n 0 temptrace-$1.bin | grep -E "frames,|frame time")
+echo "$SUMMARY"
+printf '%s %s, %s\n%s\n\n' "$(date +%Y-%m-%d)" "$1" "$MAP" "$SUMMARY" >> measurements.txt